@@ -0,0 +1,528 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <new>
+#include "attribute_value.h"
+#include "writer.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        const std::string EMPTY;
+        const std::shared_ptr<const std::string> NO_HANDLE;
+
+        /*
+         * Shortest round-trip digits of a double by Grisu3 (Florian Loitsch,
+         * "Printing floating-point numbers quickly and accurately with
+         * integers", 2010), with 64-bit integer arithmetic only. Grisu3
+         * detects the rare inputs (about 0.5%) where it cannot prove its
+         * digits shortest and closest; those fall back to exact digits.
+         */
+        struct DiyFp // f * 2^e
+        {
+            uint64_t f;
+            int e;
+        };
+
+        const uint64_t HIDDEN_BIT = uint64_t(1) << 52;
+        const uint64_t SIGNIFICAND_MASK = HIDDEN_BIT - 1;
+        const int EXPONENT_BIAS = 1023 + 52;
+        const size_t MAX_DIGITS = 17; // enough for any double to round-trip
+
+        const uint32_t POWERS_OF_10[] = {
+            1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+        };
+
+        // Normalized 10^(-348 + 8 * i), rounded to 64 bits:
+        const DiyFp CACHED_POWERS[] = {
+            {0xfa8fd5a0081c0288ull, -1220}, {0xbaaee17fa23ebf76ull, -1193}, {0x8b16fb203055ac76ull, -1166},
+            {0xcf42894a5dce35eaull, -1140}, {0x9a6bb0aa55653b2dull, -1113}, {0xe61acf033d1a45dfull, -1087},
+            {0xab70fe17c79ac6caull, -1060}, {0xff77b1fcbebcdc4full, -1034}, {0xbe5691ef416bd60cull, -1007},
+            {0x8dd01fad907ffc3cull, -980}, {0xd3515c2831559a83ull, -954}, {0x9d71ac8fada6c9b5ull, -927},
+            {0xea9c227723ee8bcbull, -901}, {0xaecc49914078536dull, -874}, {0x823c12795db6ce57ull, -847},
+            {0xc21094364dfb5637ull, -821}, {0x9096ea6f3848984full, -794}, {0xd77485cb25823ac7ull, -768},
+            {0xa086cfcd97bf97f4ull, -741}, {0xef340a98172aace5ull, -715}, {0xb23867fb2a35b28eull, -688},
+            {0x84c8d4dfd2c63f3bull, -661}, {0xc5dd44271ad3cdbaull, -635}, {0x936b9fcebb25c996ull, -608},
+            {0xdbac6c247d62a584ull, -582}, {0xa3ab66580d5fdaf6ull, -555}, {0xf3e2f893dec3f126ull, -529},
+            {0xb5b5ada8aaff80b8ull, -502}, {0x87625f056c7c4a8bull, -475}, {0xc9bcff6034c13053ull, -449},
+            {0x964e858c91ba2655ull, -422}, {0xdff9772470297ebdull, -396}, {0xa6dfbd9fb8e5b88full, -369},
+            {0xf8a95fcf88747d94ull, -343}, {0xb94470938fa89bcfull, -316}, {0x8a08f0f8bf0f156bull, -289},
+            {0xcdb02555653131b6ull, -263}, {0x993fe2c6d07b7facull, -236}, {0xe45c10c42a2b3b06ull, -210},
+            {0xaa242499697392d3ull, -183}, {0xfd87b5f28300ca0eull, -157}, {0xbce5086492111aebull, -130},
+            {0x8cbccc096f5088ccull, -103}, {0xd1b71758e219652cull, -77}, {0x9c40000000000000ull, -50},
+            {0xe8d4a51000000000ull, -24}, {0xad78ebc5ac620000ull, 3}, {0x813f3978f8940984ull, 30},
+            {0xc097ce7bc90715b3ull, 56}, {0x8f7e32ce7bea5c70ull, 83}, {0xd5d238a4abe98068ull, 109},
+            {0x9f4f2726179a2245ull, 136}, {0xed63a231d4c4fb27ull, 162}, {0xb0de65388cc8ada8ull, 189},
+            {0x83c7088e1aab65dbull, 216}, {0xc45d1df942711d9aull, 242}, {0x924d692ca61be758ull, 269},
+            {0xda01ee641a708deaull, 295}, {0xa26da3999aef774aull, 322}, {0xf209787bb47d6b85ull, 348},
+            {0xb454e4a179dd1877ull, 375}, {0x865b86925b9bc5c2ull, 402}, {0xc83553c5c8965d3dull, 428},
+            {0x952ab45cfa97a0b3ull, 455}, {0xde469fbd99a05fe3ull, 481}, {0xa59bc234db398c25ull, 508},
+            {0xf6c69a72a3989f5cull, 534}, {0xb7dcbf5354e9beceull, 561}, {0x88fcf317f22241e2ull, 588},
+            {0xcc20ce9bd35c78a5ull, 614}, {0x98165af37b2153dfull, 641}, {0xe2a0b5dc971f303aull, 667},
+            {0xa8d9d1535ce3b396ull, 694}, {0xfb9b7cd9a4a7443cull, 720}, {0xbb764c4ca7a44410ull, 747},
+            {0x8bab8eefb6409c1aull, 774}, {0xd01fef10a657842cull, 800}, {0x9b10a4e5e9913129ull, 827},
+            {0xe7109bfba19c0c9dull, 853}, {0xac2820d9623bf429ull, 880}, {0x80444b5e7aa7cf85ull, 907},
+            {0xbf21e44003acdd2dull, 933}, {0x8e679c2f5e44ff8full, 960}, {0xd433179d9c8cb841ull, 986},
+            {0x9e19db92b4e31ba9ull, 1013}, {0xeb96bf6ebadf77d9ull, 1039}, {0xaf87023b9bf0ee6bull, 1066},
+        };
+
+        DiyFp multiply(DiyFp x, DiyFp y)
+        {
+            // The upper 64 bits of the 128-bit product, rounded:
+            const uint64_t mask = 0xffffffffu;
+            uint64_t a = x.f >> 32, b = x.f & mask, c = y.f >> 32, d = y.f & mask;
+            uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+            uint64_t middle = (bd >> 32) + (ad & mask) + (bc & mask) + (uint64_t(1) << 31);
+            return DiyFp{ac + (ad >> 32) + (bc >> 32) + (middle >> 32), x.e + y.e + 64};
+        }
+        DiyFp normalize(DiyFp x)
+        {
+            while (!(x.f & (uint64_t(1) << 63))) {
+                x.f <<= 1;
+                --x.e;
+            }
+            return x;
+        }
+        /* Get the cached power c with c.e + e in [-60, -32], and its decimal exponent -k */
+        DiyFp cached_power(int e, int& k)
+        {
+            double dk = (-61 - e) * 0.30102999566398114 + 347; // log10(2)
+            int rounded = static_cast<int>(dk);
+            if (dk - rounded > 0.0) {
+                ++rounded;
+            }
+            size_t index = static_cast<size_t>((rounded >> 3) + 1);
+            k = -(-348 + static_cast<int>(index) * 8);
+            return CACHED_POWERS[index];
+        }
+        size_t count_digits(uint32_t n)
+        {
+            size_t count = 1;
+            while (count < 10 && n >= POWERS_OF_10[count]) {
+                ++count;
+            }
+            return count;
+        }
+        /*
+         * Move the last digit towards the scaled value (at `distance` below
+         * the upper bound) while staying in the safe interval; return false
+         * if the imprecision `unit` of the scaled values leaves the closest
+         * digits in doubt.
+         */
+        bool round_weed(char* digits, size_t length, uint64_t distance, uint64_t unsafe_interval,
+            uint64_t rest, uint64_t ten_kappa, uint64_t unit)
+        {
+            uint64_t small_distance = distance - unit;
+            uint64_t big_distance = distance + unit;
+            while (rest < small_distance && unsafe_interval - rest >= ten_kappa
+                && (rest + ten_kappa < small_distance
+                    || small_distance - rest >= rest + ten_kappa - small_distance)) {
+                --digits[length - 1];
+                rest += ten_kappa;
+            }
+            if (rest < big_distance && unsafe_interval - rest >= ten_kappa
+                && (rest + ten_kappa < big_distance
+                    || big_distance - rest > rest + ten_kappa - big_distance)) {
+                return false;
+            }
+            return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+        }
+        /* Generate the shortest digits between the scaled bounds `low` and `high`, see Grisu3 */
+        bool generate_digits(DiyFp low, DiyFp w, DiyFp high, char* digits, size_t& length, int& k)
+        {
+            uint64_t unit = 1;
+            uint64_t too_low = low.f - unit;
+            uint64_t too_high = high.f + unit;
+            uint64_t unsafe_interval = too_high - too_low;
+            const DiyFp one{uint64_t(1) << -w.e, w.e};
+            uint32_t integral = static_cast<uint32_t>(too_high >> -one.e);
+            uint64_t fraction = too_high & (one.f - 1);
+            int kappa = static_cast<int>(count_digits(integral));
+            length = 0;
+            while (kappa > 0) {
+                uint32_t divisor = POWERS_OF_10[kappa - 1];
+                digits[length++] = static_cast<char>('0' + integral / divisor);
+                integral %= divisor;
+                --kappa;
+                uint64_t rest = (uint64_t(integral) << -one.e) + fraction;
+                if (rest < unsafe_interval) {
+                    k += kappa;
+                    return round_weed(digits, length, too_high - w.f, unsafe_interval, rest,
+                        uint64_t(divisor) << -one.e, unit);
+                }
+            }
+            for (;;) {
+                fraction *= 10;
+                unit *= 10;
+                unsafe_interval *= 10;
+                digits[length++] = static_cast<char>('0' + (fraction >> -one.e));
+                fraction &= one.f - 1;
+                --kappa;
+                if (fraction < unsafe_interval) {
+                    k += kappa;
+                    return round_weed(digits, length, (too_high - w.f) * unit, unsafe_interval, fraction,
+                        one.f, unit);
+                }
+            }
+        }
+        bool grisu3(double value, char* digits, size_t& length, int& k)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            int biased_exponent = static_cast<int>(bits >> 52) & 0x7ff;
+            DiyFp v = biased_exponent
+                ? DiyFp{(bits & SIGNIFICAND_MASK) + HIDDEN_BIT, biased_exponent - EXPONENT_BIAS}
+                : DiyFp{bits & SIGNIFICAND_MASK, 1 - EXPONENT_BIAS};
+            // Boundaries halfway to the neighbouring doubles, at the exponent of `w`:
+            DiyFp w = normalize(v);
+            DiyFp plus = normalize(DiyFp{(v.f << 1) + 1, v.e - 1});
+            DiyFp minus = v.f == HIDDEN_BIT ? DiyFp{(v.f << 2) - 1, v.e - 2} : DiyFp{(v.f << 1) - 1, v.e - 1};
+            minus.f <<= minus.e - plus.e;
+            minus.e = plus.e;
+
+            DiyFp power = cached_power(w.e, k);
+            return generate_digits(multiply(minus, power), multiply(w, power), multiply(plus, power),
+                digits, length, k);
+        }
+        /*
+         * Exact fallback: the shortest precision whose correctly rounded
+         * digits read back to `value`. The digits come from `snprintf("%e")`
+         * with the (locale-specific) decimal point skipped, and are checked
+         * in the form "<digits>e<exponent>", which reads the same in all
+         * locales.
+         */
+        size_t exact_digits(double value, char* digits, int& k)
+        {
+            char buffer[48];
+            size_t length = 0;
+            for (int precision = 1; precision <= static_cast<int>(MAX_DIGITS); ++precision) {
+                std::snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, value);
+                const char* p = buffer;
+                length = 0;
+                for (; *p != 'e'; ++p) {
+                    if (*p >= '0' && *p <= '9') {
+                        digits[length++] = *p;
+                    }
+                }
+                k = static_cast<int>(std::strtol(p + 1, nullptr, 10)) - static_cast<int>(length) + 1;
+                std::snprintf(buffer, sizeof(buffer), "%.*se%d", static_cast<int>(length), digits, k);
+                if (std::strtod(buffer, nullptr) == value) {
+                    break;
+                }
+            }
+            while (length > 1 && digits[length - 1] == '0') {
+                --length;
+                ++k;
+            }
+            return length;
+        }
+        /* Write the shortest digits of positive finite `value` and return their count; value = digits * 10^k */
+        size_t shortest_digits(double value, char* digits, int& k)
+        {
+            size_t length;
+            if (grisu3(value, digits, length, k)) {
+                return length;
+            }
+            return exact_digits(value, digits, k);
+        }
+    }
+
+    constexpr size_t AttributeValue::MAX_NUMBER_LENGTH;
+
+    AttributeValue::AttributeValue() :
+        type_(STRING),
+        shared_(false),
+        string_()
+    {}
+    AttributeValue::AttributeValue(const std::string& value) :
+        type_(STRING),
+        shared_(false),
+        string_(value)
+    {}
+    AttributeValue::AttributeValue(std::shared_ptr<const std::string> value) :
+        type_(STRING),
+        shared_(true),
+        handle_(std::move(value))
+    {}
+    AttributeValue::AttributeValue(double value) :
+        type_(REAL),
+        shared_(false),
+        real_(value)
+    {}
+    AttributeValue::AttributeValue(float value) :
+        type_(REAL),
+        shared_(false),
+        real_(value)
+    {}
+    AttributeValue::AttributeValue(const AttributeValue& other)
+    {
+        construct(other);
+    }
+    AttributeValue::AttributeValue(AttributeValue&& other) noexcept
+    {
+        construct(std::move(other));
+    }
+    AttributeValue& AttributeValue::operator=(const AttributeValue& other)
+    {
+        if (this != &other) {
+            AttributeValue copy(other); // may throw; this value is untouched then
+            destroy();
+            construct(std::move(copy));
+        }
+        return *this;
+    }
+    AttributeValue& AttributeValue::operator=(AttributeValue&& other) noexcept
+    {
+        if (this != &other) {
+            destroy();
+            construct(std::move(other));
+        }
+        return *this;
+    }
+    AttributeValue::~AttributeValue()
+    {
+        destroy();
+    }
+    void AttributeValue::destroy()
+    {
+        if (type_ == STRING) {
+            if (shared_) {
+                handle_.~shared_ptr();
+            } else {
+                string_.~basic_string();
+            }
+        }
+    }
+    void AttributeValue::construct(const AttributeValue& other)
+    {
+        type_ = other.type_;
+        shared_ = other.shared_;
+        if (type_ == INTEGER) {
+            integer_ = other.integer_;
+        } else if (type_ == REAL) {
+            real_ = other.real_;
+        } else if (shared_) {
+            new (&handle_) std::shared_ptr<const std::string>(other.handle_);
+        } else {
+            new (&string_) std::string(other.string_);
+        }
+    }
+    void AttributeValue::construct(AttributeValue&& other)
+    {
+        type_ = other.type_;
+        shared_ = other.shared_;
+        if (type_ == INTEGER) {
+            integer_ = other.integer_;
+        } else if (type_ == REAL) {
+            real_ = other.real_;
+        } else if (shared_) {
+            new (&handle_) std::shared_ptr<const std::string>(std::move(other.handle_));
+        } else {
+            new (&string_) std::string(std::move(other.string_));
+        }
+    }
+    AttributeValue::Type AttributeValue::type() const
+    {
+        return type_;
+    }
+    bool AttributeValue::isNumber() const
+    {
+        return type_ != STRING;
+    }
+    std::string AttributeValue::str() const
+    {
+        if (type_ == STRING) {
+            return *string();
+        }
+        std::string result;
+        appendTo(result);
+        return result;
+    }
+    void AttributeValue::appendTo(std::string& out) const
+    {
+        char buffer[MAX_NUMBER_LENGTH];
+        switch (type_) {
+        case STRING:
+            out += *string();
+            break;
+        case INTEGER:
+            out.append(buffer, format(integer_, buffer));
+            break;
+        case REAL:
+            out.append(buffer, format(real_, buffer));
+            break;
+        }
+    }
+    const std::string* AttributeValue::string() const
+    {
+        if (type_ != STRING) {
+            return nullptr;
+        }
+        if (shared_) {
+            return handle_ ? handle_.get() : &EMPTY;
+        }
+        return &string_;
+    }
+    const std::shared_ptr<const std::string>& AttributeValue::shared() const
+    {
+        return type_ == STRING && shared_ ? handle_ : NO_HANDLE;
+    }
+    void AttributeValue::write(Writer& out) const
+    {
+        char buffer[MAX_NUMBER_LENGTH];
+        switch (type_) {
+        case STRING:
+            out.writeRef(*string());
+            break;
+        case INTEGER:
+            out.write(buffer, format(integer_, buffer));
+            break;
+        case REAL:
+            out.write(buffer, format(real_, buffer));
+            break;
+        }
+    }
+    int64_t AttributeValue::toInteger() const
+    {
+        switch (type_) {
+        case INTEGER:
+            return integer_;
+        case REAL:
+            // Converting NaN or an out of range double is undefined, so clamp:
+            if (std::isnan(real_)) {
+                return 0;
+            }
+            if (real_ >= 9223372036854775808.0) { // 2^63
+                return std::numeric_limits<int64_t>::max();
+            }
+            if (real_ < -9223372036854775808.0) {
+                return std::numeric_limits<int64_t>::min();
+            }
+            return static_cast<int64_t>(real_);
+        default:
+            return std::strtoll(string()->c_str(), nullptr, 10);
+        }
+    }
+    double AttributeValue::toReal() const
+    {
+        switch (type_) {
+        case INTEGER:
+            return static_cast<double>(integer_);
+        case REAL:
+            return real_;
+        default:
+            return std::strtod(string()->c_str(), nullptr);
+        }
+    }
+    bool AttributeValue::operator==(const AttributeValue& other) const
+    {
+        if (type_ == STRING && other.type_ == STRING) {
+            return string() == other.string() || *string() == *other.string();
+        }
+        if (type_ == INTEGER && other.type_ == INTEGER) {
+            return integer_ == other.integer_;
+        }
+        return str() == other.str();
+    }
+    bool AttributeValue::operator!=(const AttributeValue& other) const
+    {
+        return !(*this == other);
+    }
+    bool AttributeValue::operator==(const std::string& other) const
+    {
+        if (type_ == STRING) {
+            return *string() == other;
+        }
+        char buffer[MAX_NUMBER_LENGTH];
+        size_t length = type_ == INTEGER ? format(integer_, buffer) : format(real_, buffer);
+        return other.compare(0, std::string::npos, buffer, length) == 0;
+    }
+    size_t AttributeValue::format(int64_t value, char* buffer)
+    {
+        // Digits are produced backwards, from the least significant one:
+        char digits[MAX_NUMBER_LENGTH];
+        size_t n = 0;
+        uint64_t magnitude = value < 0
+            ? 0 - static_cast<uint64_t>(value)
+            : static_cast<uint64_t>(value);
+        do {
+            digits[n++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        size_t length = 0;
+        if (value < 0) {
+            buffer[length++] = '-';
+        }
+        while (n) {
+            buffer[length++] = digits[--n];
+        }
+        buffer[length] = '\0';
+        return length;
+    }
+    size_t AttributeValue::format(double value, char* buffer)
+    {
+        if (std::isfinite(value) && value == std::trunc(value) && std::fabs(value) < 1e15) {
+            // Whole numbers (the common case for coordinates) need no exponent:
+            return format(static_cast<int64_t>(value), buffer);
+        }
+        size_t length = 0;
+        if (std::signbit(value)) {
+            buffer[length++] = '-';
+            value = -value;
+        }
+        if (std::isnan(value)) {
+            std::strcpy(buffer, "nan");
+            return 3;
+        }
+        if (std::isinf(value)) {
+            std::strcpy(buffer + length, "inf");
+            return length + 3;
+        }
+        char digits[MAX_DIGITS + 3];
+        int k = 0;
+        size_t count = shortest_digits(value, digits, k);
+        // Laid out as `printf("%.<count>g")`: positional unless the exponent
+        // is below -4 or not below the number of digits.
+        int exponent = static_cast<int>(count) + k - 1;
+        if (exponent >= -4 && exponent < static_cast<int>(count)) {
+            if (exponent < 0) {
+                buffer[length++] = '0';
+                buffer[length++] = '.';
+                for (int i = -1; i > exponent; --i) {
+                    buffer[length++] = '0';
+                }
+                std::memcpy(buffer + length, digits, count);
+                length += count;
+            } else {
+                size_t integral = static_cast<size_t>(exponent) + 1;
+                std::memcpy(buffer + length, digits, integral);
+                length += integral;
+                if (count > integral) {
+                    buffer[length++] = '.';
+                    std::memcpy(buffer + length, digits + integral, count - integral);
+                    length += count - integral;
+                }
+            }
+        } else {
+            buffer[length++] = digits[0];
+            if (count > 1) {
+                buffer[length++] = '.';
+                std::memcpy(buffer + length, digits + 1, count - 1);
+                length += count - 1;
+            }
+            buffer[length++] = 'e';
+            buffer[length++] = exponent < 0 ? '-' : '+';
+            int magnitude = exponent < 0 ? -exponent : exponent;
+            if (magnitude >= 100) {
+                buffer[length++] = static_cast<char>('0' + magnitude / 100);
+            }
+            buffer[length++] = static_cast<char>('0' + magnitude / 10 % 10);
+            buffer[length++] = static_cast<char>('0' + magnitude % 10);
+        }
+        buffer[length] = '\0';
+        return length;
+    }
+}
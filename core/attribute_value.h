@@ -0,0 +1,94 @@
+#ifndef _ATTRIBUTE_VALUE_H
+#define _ATTRIBUTE_VALUE_H
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <type_traits>
+
+namespace SeeQuery
+{
+    class Writer;
+
+    /**
+     * Value of an element attribute: a string, a 64-bit integer or a double.
+     *
+     * Numbers are kept in binary form and only formatted when the value is
+     * read as a string or serialized, so coordinates that are overwritten
+     * before output are never formatted at all. Formatting is independent of
+     * the C locale; doubles are printed in the shortest form that reads back
+     * to the same value.
+     *
+     * Strings are held inline, as a `std::string`, unless they are shared:
+     * a value made from a shared string (such as a pooled one) keeps the
+     * handle, and copies of it share the string. Setting a new value replaces
+     * the string instead of modifying it.
+     */
+    class AttributeValue
+    {
+    public:
+        enum Type {
+            STRING,
+            INTEGER,
+            REAL
+        };
+
+        /* Longest formatted number, including the terminating zero: */
+        static constexpr size_t MAX_NUMBER_LENGTH = 32;
+
+        AttributeValue();
+        AttributeValue(const std::string& value); /** Hold a copy of `value` inline */
+        AttributeValue(std::shared_ptr<const std::string> value); /** Share an existing string */
+        AttributeValue(double value);
+        AttributeValue(float value);
+        template <class T, class = typename std::enable_if<std::is_integral<T>::value>::type>
+        AttributeValue(T value) :
+            type_(INTEGER),
+            shared_(false),
+            integer_(static_cast<int64_t>(value))
+        {}
+        AttributeValue(const AttributeValue& other);
+        AttributeValue(AttributeValue&& other) noexcept;
+        AttributeValue& operator=(const AttributeValue& other);
+        AttributeValue& operator=(AttributeValue&& other) noexcept;
+        ~AttributeValue();
+
+        Type type() const; /** Get the type of the stored value */
+        bool isNumber() const; /** Return true if the value is stored as a number */
+
+        std::string str() const; /** Get the value formatted as a string */
+        void appendTo(std::string& out) const; /** Append the formatted value to `out` */
+        void write(Writer& out) const; /** Write the formatted value, strings by reference */
+        const std::string* string() const; /** Get the stored string without copying, null for numbers */
+        const std::shared_ptr<const std::string>& shared() const; /** Get the shared string, null unless shared */
+        int64_t toInteger() const; /** Get the value as an integer, parsing strings if needed; NaN is 0, others clamp */
+        double toReal() const; /** Get the value as a double, parsing strings if needed */
+
+        bool operator==(const AttributeValue& other) const; /** Compare formatted values */
+        bool operator!=(const AttributeValue& other) const;
+        bool operator==(const std::string& other) const; /** Compare the formatted value with `other` */
+
+        /**
+         * Format a number into `buffer` (at least `MAX_NUMBER_LENGTH` bytes) and
+         * return the length of the result.
+         */
+        static size_t format(int64_t value, char* buffer);
+        static size_t format(double value, char* buffer);
+
+    private:
+        void destroy(); /** End the lifetime of the active member */
+        void construct(const AttributeValue& other); /** Copy `other` into this destroyed value */
+        void construct(AttributeValue&& other); /** Move `other` into this destroyed value */
+
+        Type type_;
+        bool shared_; // a string held by `handle_` rather than `string_`
+        union {
+            int64_t integer_;
+            double real_;
+            std::string string_;
+            std::shared_ptr<const std::string> handle_; // may be null for the empty string
+        };
+    };
+}
+
+#endif // _ATTRIBUTE_VALUE_H
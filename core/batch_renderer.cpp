@@ -0,0 +1,146 @@
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "batch_renderer.h"
+#include "writer.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        void write_file(const std::string& path, const std::string& data)
+        {
+            int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "open " + path);
+            }
+            size_t done = 0;
+            while (done < data.size()) {
+                ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0) {
+                    int error = errno;
+                    ::close(fd);
+                    throw std::system_error(error, std::generic_category(), "write " + path);
+                }
+                done += static_cast<size_t>(n);
+            }
+            if (::close(fd) != 0) {
+                throw std::system_error(errno, std::generic_category(), "close " + path);
+            }
+        }
+    }
+
+    double BatchRenderer::Stats::documentsPerSecond() const
+    {
+        return seconds > 0 ? documents / seconds : 0;
+    }
+    double BatchRenderer::Stats::bytesPerSecond() const
+    {
+        return seconds > 0 ? bytes / seconds : 0;
+    }
+
+    BatchRenderer::BatchRenderer(ThreadPool& pool, size_t max_in_flight) :
+        pool_(pool),
+        max_in_flight_(max_in_flight ? max_in_flight : 2 * pool.size())
+    {}
+    size_t BatchRenderer::maxInFlight() const
+    {
+        return max_in_flight_;
+    }
+    BatchRenderer::Stats BatchRenderer::run(const Generator& next)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Stats stats;
+        std::mutex mutex; // guards `stats`, `in_flight` and `buffers`
+        std::condition_variable slot;
+        size_t in_flight = 0;
+        // Idle output buffers, reused with their capacity; there is at most
+        // one per job in flight, and all are freed when the run ends:
+        std::vector<std::unique_ptr<StringWriter>> buffers;
+        buffers.reserve(max_in_flight_);
+        auto drain = [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            slot.wait(lock, [&]() { return in_flight == 0; });
+        };
+
+        Job job;
+        try {
+            while (next(job)) {
+                std::shared_ptr<Job> task = std::make_shared<Job>(std::move(job));
+                job = Job();
+                {
+                    // Backpressure: wait for a job to finish before pulling more.
+                    std::unique_lock<std::mutex> lock(mutex);
+                    slot.wait(lock, [&]() { return in_flight < max_in_flight_; });
+                    ++in_flight;
+                    stats.peak_in_flight = std::max(stats.peak_in_flight, in_flight);
+                }
+                try {
+                    pool_.submit([task, &stats, &mutex, &slot, &in_flight, &buffers]() {
+                        std::unique_ptr<StringWriter> buffer;
+                        size_t bytes = 0;
+                        std::string error;
+                        try {
+                            {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                if (!buffers.empty()) {
+                                    buffer = std::move(buffers.back());
+                                    buffers.pop_back();
+                                }
+                            }
+                            if (!buffer) {
+                                buffer.reset(new StringWriter);
+                            }
+                            buffer->str().clear();
+                            {
+                                SeeQuery $;
+                                task->build($);
+                                $.serialize(*buffer);
+                            }
+                            write_file(task->path, buffer->str());
+                            bytes = buffer->str().size();
+                        } catch (const std::exception& e) {
+                            error = e.what();
+                        } catch (...) {
+                            error = "unknown error";
+                        }
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (buffer) {
+                            buffers.push_back(std::move(buffer)); // within the reserved capacity
+                        }
+                        if (error.empty()) {
+                            ++stats.documents;
+                            stats.bytes += bytes;
+                        } else if (stats.failed++ == 0) {
+                            stats.first_error = error;
+                        }
+                        --in_flight;
+                        slot.notify_all();
+                    });
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    --in_flight;
+                    throw;
+                }
+            }
+        } catch (...) {
+            // The running jobs refer to the locals of this call:
+            drain();
+            throw;
+        }
+        drain();
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+}
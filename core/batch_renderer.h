@@ -0,0 +1,70 @@
+#ifndef _BATCH_RENDERER_H
+#define _BATCH_RENDERER_H
+
+#include <functional>
+#include <string>
+#include "collection.h"
+#include "thread_pool.h"
+
+namespace SeeQuery
+{
+    /**
+     * Renders many independent documents concurrently: every job builds a
+     * fresh `SeeQuery` document, serializes it and writes it to a file, on
+     * the workers of a `ThreadPool`.
+     *
+     * Jobs are pulled from a generator only while fewer than
+     * `maxInFlight()` are queued or running, so a generator producing
+     * millions of jobs never has more than a few in memory. Jobs serialize
+     * into buffers owned by the run, reused (with their capacity) by later
+     * jobs and freed when the run ends, and write them with as few system
+     * calls as possible.
+     *
+     * A failing job (an exception from `build`, a file error) is counted and
+     * does not stop the others.
+     */
+    class BatchRenderer
+    {
+    public:
+        struct Job
+        {
+            std::function<void(SeeQuery&)> build; // fills the document
+            std::string path; // file the markup is written to
+        };
+
+        /** Fill `job` and return true, or return false when there are no more jobs */
+        typedef std::function<bool(Job& job)> Generator;
+
+        struct Stats
+        {
+            size_t documents = 0; // jobs completed successfully
+            size_t failed = 0;
+            size_t bytes = 0; // markup written
+            size_t peak_in_flight = 0;
+            double seconds = 0; // wall-clock time of the run
+            std::string first_error; // message of the first failure
+
+            double documentsPerSecond() const;
+            double bytesPerSecond() const;
+        };
+
+        /** Run on `pool`, with at most `max_in_flight` jobs at a time (twice the workers if 0) */
+        explicit BatchRenderer(ThreadPool& pool, size_t max_in_flight = 0);
+
+        size_t maxInFlight() const;
+
+        /**
+         * Run all the jobs of `next` and return when they have finished. The
+         * calling thread runs the generator; it must not be a worker of the
+         * pool. An exception from `next` is rethrown once the jobs already
+         * pulled have finished.
+         */
+        Stats run(const Generator& next);
+
+    private:
+        ThreadPool& pool_;
+        size_t max_in_flight_;
+    };
+}
+
+#endif // _BATCH_RENDERER_H
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <iterator>
+#include "child_index.h"
+#include "node.h"
+
+namespace SeeQuery
+{
+    constexpr size_t ChildIndex::FANOUT;
+
+    ChildIndex::ChildIndex(const Node& parent)
+    {
+        // Children come in order, so they fill the blocks left to right:
+        std::vector<std::unique_ptr<Block>> level;
+        for (Node* child = parent.firstChild(); child; child = child->nextSibling()) {
+            if (level.empty() || level.back()->nodes.size() == FANOUT) {
+                level.push_back(block(true));
+            }
+            level.back()->nodes.push_back(child);
+        }
+        while (level.size() > 1) {
+            std::vector<std::unique_ptr<Block>> upper;
+            for (auto& lower: level) {
+                lower->update();
+                if (upper.empty() || upper.back()->blocks.size() == FANOUT) {
+                    upper.push_back(block(false));
+                }
+                upper.back()->blocks.push_back(std::move(lower));
+            }
+            level.swap(upper);
+        }
+        root_ = level.empty() ? block(true) : std::move(level.front());
+        root_->update();
+    }
+    ChildIndex::~ChildIndex()
+    {}
+    size_t ChildIndex::size() const
+    {
+        return root_->count;
+    }
+    Node* ChildIndex::at(size_t index) const
+    {
+        if (index >= root_->count) {
+            return nullptr;
+        }
+        const Block* block = root_.get();
+        while (!block->leaf()) {
+            for (auto& child: block->blocks) {
+                if (index < child->count) {
+                    block = child.get();
+                    break;
+                }
+                index -= child->count;
+            }
+        }
+        return block->nodes[index];
+    }
+    size_t ChildIndex::indexOf(const Node* child) const
+    {
+        size_t index = 0;
+        const Block* block = root_.get();
+        while (!block->leaf()) {
+            size_t i = block->find(child);
+            for (size_t j = 0; j < i; ++j) {
+                index += block->blocks[j]->count;
+            }
+            block = block->blocks[i].get();
+        }
+        return index + block->find(child);
+    }
+    void ChildIndex::insert(Node* child)
+    {
+        std::unique_ptr<Block> right = insert(*root_, child);
+        if (right) {
+            std::unique_ptr<Block> root = block(false);
+            root->blocks.push_back(std::move(root_));
+            root->blocks.push_back(std::move(right));
+            root->update();
+            root_ = std::move(root);
+        }
+    }
+    void ChildIndex::erase(const Node* child)
+    {
+        erase(*root_, child);
+        while (!root_->leaf() && root_->blocks.size() == 1) {
+            root_ = std::move(root_->blocks.front());
+            --blocks_;
+        }
+    }
+    size_t ChildIndex::bytes() const
+    {
+        // Leaves hold nodes and inner blocks hold blocks, pointer-sized alike:
+        return sizeof(ChildIndex) + blocks_ * (sizeof(Block) + (FANOUT + 1) * sizeof(Node*));
+    }
+    std::unique_ptr<ChildIndex::Block> ChildIndex::block(bool leaf)
+    {
+        std::unique_ptr<Block> block(new Block);
+        if (leaf) {
+            block->nodes.reserve(FANOUT + 1);
+        } else {
+            block->blocks.reserve(FANOUT + 1);
+        }
+        ++blocks_;
+        return block;
+    }
+    std::unique_ptr<ChildIndex::Block> ChildIndex::insert(Block& block, Node* child)
+    {
+        std::unique_ptr<Block> right;
+        size_t i = block.find(child);
+        if (block.leaf()) {
+            block.nodes.insert(block.nodes.begin() + i, child);
+            if (block.nodes.size() > FANOUT) {
+                right = this->block(true);
+                right->nodes.assign(block.nodes.begin() + FANOUT / 2, block.nodes.end());
+                block.nodes.resize(FANOUT / 2);
+            }
+        } else {
+            // Past the last block, the child goes to the end of the last one:
+            i = std::min(i, block.blocks.size() - 1);
+            if (std::unique_ptr<Block> split = insert(*block.blocks[i], child)) {
+                block.blocks.insert(block.blocks.begin() + i + 1, std::move(split));
+            }
+            if (block.blocks.size() > FANOUT) {
+                right = this->block(false);
+                std::move(block.blocks.begin() + FANOUT / 2, block.blocks.end(), std::back_inserter(right->blocks));
+                block.blocks.resize(FANOUT / 2);
+            }
+        }
+        block.update();
+        if (right) {
+            right->update();
+        }
+        return right;
+    }
+    void ChildIndex::erase(Block& block, const Node* child)
+    {
+        size_t i = block.find(child);
+        if (block.leaf()) {
+            if (i < block.nodes.size() && block.nodes[i] == child) {
+                block.nodes.erase(block.nodes.begin() + i);
+            }
+        } else if (i < block.blocks.size()) {
+            // Blocks may get sparse, but empty ones are dropped:
+            erase(*block.blocks[i], child);
+            if (block.blocks[i]->count == 0) {
+                block.blocks.erase(block.blocks.begin() + i);
+                --blocks_;
+            }
+        }
+        block.update();
+    }
+
+    size_t ChildIndex::Block::find(const Node* child) const
+    {
+        if (leaf()) {
+            return std::lower_bound(nodes.begin(), nodes.end(), child, [](const Node* a, const Node* b) {
+                return a->precedes(*b);
+            }) - nodes.begin();
+        }
+        return std::lower_bound(blocks.begin(), blocks.end(), child,
+            [](const std::unique_ptr<Block>& a, const Node* b) {
+                return a->last->precedes(*b);
+            }) - blocks.begin();
+    }
+    void ChildIndex::Block::update()
+    {
+        if (leaf()) {
+            count = nodes.size();
+            last = nodes.empty() ? nullptr : nodes.back();
+        } else {
+            count = 0;
+            for (auto& block: blocks) {
+                count += block->count;
+            }
+            last = blocks.empty() ? nullptr : blocks.back()->last;
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef _CHILD_INDEX_H
+#define _CHILD_INDEX_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace SeeQuery
+{
+    class Node;
+
+    /**
+     * Positional index over the children of one node (see
+     * `Node::indexChildren()`): a counted B-tree with a large fanout, giving
+     * the child at a position and the position of a child in O(log n).
+     *
+     * Children are ordered by their document order labels, so insertions
+     * and removals need no position: the index finds it. It is kept up to
+     * date by the methods linking and detaching nodes.
+     */
+    class ChildIndex
+    {
+    public:
+        static constexpr size_t FANOUT = 64; // entries per block
+
+        explicit ChildIndex(const Node& parent); /** Index the current children of `parent` */
+        ~ChildIndex();
+
+        size_t size() const;
+        Node* at(size_t index) const; /** Get the child at `index`, null if out of range */
+        size_t indexOf(const Node* child) const; /** Get the position of `child`, which must be indexed */
+        void insert(Node* child); /** Add a child, already linked and labeled */
+        void erase(const Node* child); /** Remove a child, before it is unlinked */
+        size_t bytes() const; /** Get the bytes held by the index, see `MemoryAccount` */
+
+    private:
+        struct Block
+        {
+            size_t count = 0; // children in the block and the blocks under it
+            Node* last = nullptr; // last child of the block, the search key
+            std::vector<Node*> nodes; // children, in leaves
+            std::vector<std::unique_ptr<Block>> blocks; // in inner blocks
+
+            bool leaf() const { return blocks.empty(); }
+            size_t find(const Node* child) const; /** Get the first entry not before `child` */
+            void update(); /** Recompute `count` and `last` from the entries */
+        };
+
+        /** Make an empty block, with room for a full one so that it never reallocates */
+        std::unique_ptr<Block> block(bool leaf);
+        std::unique_ptr<Block> insert(Block& block, Node* child); /** Return the new right half if split */
+        void erase(Block& block, const Node* child);
+
+        std::unique_ptr<Block> root_;
+        size_t blocks_ = 0;
+    };
+}
+
+#endif // _CHILD_INDEX_H
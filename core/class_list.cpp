@@ -0,0 +1,112 @@
+#include <algorithm>
+#include "class_list.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        bool is_space(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\f' || c == '\r';
+        }
+
+        /* Bytes of a table entry besides the name: the hash table node (entry, link and cached hash): */
+        const size_t ENTRY_OVERHEAD = sizeof(std::pair<const std::string, ClassTable::Token>) + 2 * sizeof(void*);
+    }
+
+    constexpr ClassTable::Token ClassTable::NONE;
+    constexpr ClassList::Token ClassList::NONE;
+
+    ClassTable::Token ClassTable::intern(const std::string& class_name)
+    {
+        auto it = tokens_.find(class_name);
+        if (it != tokens_.end()) {
+            return it->second;
+        }
+        Token token = static_cast<Token>(tokens_.size());
+        tokens_.insert(std::make_pair(class_name, token));
+        bytes_ += ENTRY_OVERHEAD + class_name.size();
+        return token;
+    }
+    ClassTable::Token ClassTable::find(const std::string& class_name) const
+    {
+        auto it = tokens_.find(class_name);
+        return it != tokens_.end() ? it->second : NONE;
+    }
+    size_t ClassTable::size() const
+    {
+        return tokens_.size();
+    }
+    size_t ClassTable::bytes() const
+    {
+        return bytes_;
+    }
+
+    void ClassList::assign(const std::string& value, ClassTable& table)
+    {
+        tokens_.clear();
+        for (auto& class_name: split(value)) {
+            tokens_.push_back(table.intern(class_name));
+        }
+        std::sort(tokens_.begin(), tokens_.end());
+        tokens_.erase(std::unique(tokens_.begin(), tokens_.end()), tokens_.end());
+    }
+    void ClassList::clear()
+    {
+        tokens_.clear();
+    }
+    bool ClassList::contains(Token token) const
+    {
+        return std::binary_search(tokens_.begin(), tokens_.end(), token);
+    }
+    bool ClassList::empty() const
+    {
+        return tokens_.empty();
+    }
+    size_t ClassList::size() const
+    {
+        return tokens_.size();
+    }
+    const std::vector<ClassList::Token>& ClassList::tokens() const
+    {
+        return tokens_;
+    }
+    std::vector<std::string> ClassList::split(const std::string& value)
+    {
+        std::vector<std::string> class_names;
+        size_t i = 0;
+        while (i < value.size()) {
+            if (is_space(value[i])) {
+                ++i;
+                continue;
+            }
+            size_t begin = i;
+            while (i < value.size() && !is_space(value[i])) {
+                ++i;
+            }
+            class_names.push_back(value.substr(begin, i - begin));
+        }
+        return class_names;
+    }
+    bool ClassList::contains(const char* value, size_t length, const std::string& class_name)
+    {
+        if (class_name.empty()) {
+            return false;
+        }
+        size_t i = 0;
+        while (i < length) {
+            if (is_space(value[i])) {
+                ++i;
+                continue;
+            }
+            size_t begin = i;
+            while (i < length && !is_space(value[i])) {
+                ++i;
+            }
+            if (i - begin == class_name.size() && class_name.compare(0, class_name.size(), value + begin, i - begin) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef _CLASS_LIST_H
+#define _CLASS_LIST_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace SeeQuery
+{
+    /**
+     * Class names of one document numbered as tokens (see
+     * `Document::classTable()`). Like the rest of a document it is only
+     * modified by the thread building the document, so it needs no lock;
+     * lookups from queries on a frozen document only read it.
+     */
+    class ClassTable
+    {
+    public:
+        typedef uint32_t Token;
+        static constexpr Token NONE = 0xffffffff;
+
+        Token intern(const std::string& class_name); /** Get the token of `class_name`, adding it if needed */
+        Token find(const std::string& class_name) const; /** Get the token of `class_name`, `NONE` if never seen */
+        size_t size() const; /** Get the number of class names */
+        size_t bytes() const; /** Get the bytes held by the entries, see `MemoryAccount` */
+
+    private:
+        std::unordered_map<std::string, Token> tokens_;
+        size_t bytes_ = 0;
+    };
+
+    /**
+     * Set of the whitespace-separated tokens of a `class` attribute.
+     *
+     * Tokens come from the class table of the document (class names are a
+     * small vocabulary) and are kept as a sorted vector of integers, so
+     * checking an element for a class is a binary search over a few
+     * integers instead of tokenizing the attribute on every query.
+     */
+    class ClassList
+    {
+    public:
+        typedef ClassTable::Token Token;
+        static constexpr Token NONE = ClassTable::NONE;
+
+        void assign(const std::string& value, ClassTable& table); /** Replace the tokens with those of `value` */
+        void clear();
+        bool contains(Token token) const;
+        bool empty() const;
+        size_t size() const;
+        const std::vector<Token>& tokens() const; /** Get the tokens in ascending order */
+
+        /* Return true if the class list `value` (`length` bytes) contains `class_name`: */
+        static bool contains(const char* value, size_t length, const std::string& class_name);
+        static std::vector<std::string> split(const std::string& value); /** Get the class names of `value` */
+
+    private:
+        std::vector<Token> tokens_; // sorted, unique
+    };
+}
+
+#endif // _CLASS_LIST_H
@@ -1,5 +1,9 @@
+#include <unordered_set>
 #include "collection.h"
 #include "dom.h"
+#include "document.h"
+#include "trace.h"
+#include "selector.h"
 
 namespace SeeQuery
 {
@@ -27,14 +31,29 @@ namespace SeeQuery
     }
     std::string Collection::serialize() const
     {
-        std::ostringstream oss;
+        // Measure first, so the output is built in a single allocation:
+        CountingWriter counter;
         for (auto& child: children_) {
-            oss << child->serialize() << std::endl;
+            child->serialize(counter);
         }
-        return oss.str();
+        StringWriter out;
+        out.reserve(counter.size() + children_.size());
+        serialize(out);
+        return std::move(out.str());
+    }
+    void Collection::serialize(Writer& out) const
+    {
+        TraceScope trace("Collection::serialize");
+        for (auto& child: children_) {
+            child->serialize(out);
+            out.writeRef("\n", 1);
+        }
+        trace.size(children_.size());
     }
     Collection& Collection::append(const Collection& collection)
     {
+        TraceScope trace("Collection::append");
+        trace.size(children_.size());
         if (children_.empty()) {
             return *this;
         }
@@ -58,6 +77,8 @@ namespace SeeQuery
     }
     Collection& Collection::prepend(const Collection& collection)
     {
+        TraceScope trace("Collection::prepend");
+        trace.size(children_.size());
         if (children_.empty()) {
             return *this;
         }
@@ -81,6 +102,8 @@ namespace SeeQuery
     }
     Collection& Collection::after(const Collection& collection)
     {
+        TraceScope trace("Collection::after");
+        trace.size(children_.size());
         if (children_.empty()) {
             return *this;
         }
@@ -102,6 +125,8 @@ namespace SeeQuery
     }
     Collection& Collection::before(const Collection& collection)
     {
+        TraceScope trace("Collection::before");
+        trace.size(children_.size());
         if (children_.empty()) {
             return *this;
         }
@@ -123,6 +148,8 @@ namespace SeeQuery
     }
     Collection& Collection::remove()
     {
+        TraceScope trace("Collection::remove");
+        trace.size(children_.size());
         for (auto element: children_) {
             // remove the element from where it was:
             decrement_root(get_root(element));
@@ -135,84 +162,244 @@ namespace SeeQuery
     {
         return children_.size();
     }
+    Collection::iterator Collection::begin() const
+    {
+        return iterator(children_.begin());
+    }
+    Collection::iterator Collection::end() const
+    {
+        return iterator(children_.end());
+    }
     Collection Collection::operator()(std::string query, 
         std::initializer_list<Attribute> attributes/* = {}*/)
     {
+        TraceScope trace("Collection::operator()", query);
         if (query.empty()) {
+            trace.size(children_.size());
             return *this;
         }
 
-        // Check if the query string is something like: '<tag/>' or '<tag></tag>':
-        std::regex re_single_tag(R"(^<([\w-]+)\s*\/?>(?:<\/\1>|)$)");
-        std::smatch single_tag_match;
-        std::regex_match(query, single_tag_match, re_single_tag);
-        // If it is, create new element:
-        if (!single_tag_match.empty()) {
+        Selector selector(query);
+        // If the query is something like '<tag/>' or '<tag></tag>', create new element:
+        if (selector.type() == Selector::CREATE) {
             Collection result;
-            result.push_back(new HtmlNode(single_tag_match[1], attributes));
+            // New elements belong to the document of this collection:
+            auto document = children_.empty() ? nullptr : children_.front()->ownerDocument();
+            result.push_back(new HtmlNode(selector.value(), attributes, document));
+            trace.size(result.size());
             return result;
         }
 
-        std::string tag_name, id, class_name;
-
-        std::regex re_quick_expr(R"(^(?:#([\w-]+)|(\w+)|\.([\w-]+))$)");
-        std::smatch quick_expr_match;
-        std::regex_match(query, quick_expr_match, re_quick_expr);
+        // Otherwise search every element (empty result for unsupported queries):
+        Collection result;
+        Document* document = cacheDocument();
+        uint64_t generation = document ? document->generation() : 0;
+        QueryCache::Result found;
+        if (document) {
+            found = document->queryCache().find(children_.front(), query, generation);
+        }
+        if (!found) {
+            std::vector<Node*> nodes;
+            for (auto& element: children_) {
+                selector.select(element, nodes);
+            }
+            if (children_.size() > 1) {
+                // Nested elements find the same nodes, and in another order:
+                Node::sortInDocumentOrder(nodes);
+            }
+            found = std::make_shared<const std::vector<Node*>>(std::move(nodes));
+            if (document) {
+                document->queryCache().store(children_.front(), query, generation, found);
+            }
+        }
+        for (Node* node: *found) {
+            result.push_back(node);
+        }
+        trace.size(result.size());
+        return result;
+    }
+    Collection Collection::operator()(const std::string& query, ThreadPool& pool)
+    {
+        Selector selector(query);
+        if (selector.type() == Selector::CREATE || selector.type() == Selector::INVALID) {
+            return (*this)(query);
+        }
+        TraceScope trace("Collection::operator()", query);
+        // The query cache is bypassed: its lock would serialize the threads
+        // querying a frozen document, and results this large are cheaper to
+        // recompute in parallel than to keep.
 
-        if (quick_expr_match.size() >= 3) {
-            std::string id = quick_expr_match[1];
-            std::string tag_name = quick_expr_match[2];
-            std::string class_name = quick_expr_match[3];
-            Collection result;
-            if (!id.empty()) {
-                for (auto& element: children_) {
-                    auto node = element->getElementById(id);
-                    if (node) {
-                        result.push_back(node);
-                    }
-                }
-                return result;
-            } else if (!tag_name.empty()) {
-                for (auto& element: children_) {
-                    for (Node* node: element->getElementsByTagName(tag_name)) {
-                        result.push_back(node);
-                    }
+        // Split the subtrees into enough pieces to keep all workers busy. A
+        // piece remembers the element it came from and pieces stay in
+        // document order, so the results can be merged in order:
+        struct Piece
+        {
+            size_t owner;
+            Node* node;
+        };
+        std::vector<Piece> pieces;
+        for (auto& element: children_) {
+            pieces.push_back({pieces.size(), element});
+        }
+        const size_t target = pool.size() * 8;
+        bool split = true;
+        while (split && pieces.size() < target) {
+            split = false;
+            std::vector<Piece> next;
+            for (auto& piece: pieces) {
+                Node* child = piece.node->firstChild();
+                // A matching node is not searched further, so it is not split:
+                if (!child || selector.matches(*piece.node)) {
+                    next.push_back(piece);
+                    continue;
                 }
-                return result;
-            } else if (!class_name.empty()) {
-                for (auto& element: children_) {
-                    for (Node* node: element->getElementsByClassName(class_name)) {
-                        result.push_back(node);
-                    }
+                for (; child; child = child->nextSibling()) {
+                    next.push_back({piece.owner, child});
                 }
-                return result;
+                split = true;
             }
+            pieces.swap(next);
         }
 
-        // If nothing has been found, return empty collection:
+        std::vector<std::vector<Node*>> found(pieces.size());
+        pool.parallelFor(pieces.size(), [&](size_t i) {
+            selector.select(pieces[i].node, found[i]);
+        });
+
+        std::vector<Node*> nodes;
+        for (size_t i = 0; i < pieces.size(); ++i) {
+            nodes.insert(nodes.end(), found[i].begin(), found[i].end());
+            if (selector.type() == Selector::ID && !found[i].empty()) {
+                // Only the first element with the id in each subtree counts:
+                size_t owner = pieces[i].owner;
+                while (i + 1 < pieces.size() && pieces[i + 1].owner == owner) {
+                    ++i;
+                }
+            }
+        }
+        if (children_.size() > 1) {
+            Node::sortInDocumentOrder(nodes);
+        }
         Collection result;
+        for (Node* node: nodes) {
+            result.push_back(node);
+        }
+        trace.size(result.size());
         return result;
     }
     Collection Collection::operator[](size_t index) const
     {
         Collection result;
         if (index < children_.size()) {
-            auto it = children_.begin();
-            std::advance(it, index);
-            result.push_back(*it);
+            result.push_back(children_[index]);
         }
         return result;
     }
+    Node* Collection::get(size_t index) const
+    {
+        return index < children_.size() ? children_[index] : nullptr;
+    }
     Collection Collection::children() const
     {
         Collection result;
         for (auto node: children_) {
-            for (auto child: node->getChildren()) {
-                result.push_back(child);
+            for (Node& child: node->childNodes()) {
+                result.push_back(&child);
+            }
+        }
+        return result;
+    }
+    Collection Collection::parent() const
+    {
+        Collection result;
+        std::unordered_set<Node*> seen;
+        for (auto node: children_) {
+            Node* parent = node->parent();
+            if (parent && seen.insert(parent).second) {
+                result.push_back(parent);
             }
         }
         return result;
     }
+    Collection Collection::closest(const std::string& query) const
+    {
+        TraceScope trace("Collection::closest", query);
+        Selector selector(query);
+        Collection result;
+        std::unordered_set<Node*> seen;
+        for (auto node: children_) {
+            while (node && !selector.matches(*node)) {
+                node = node->parent();
+            }
+            if (node && seen.insert(node).second) {
+                result.push_back(node);
+            }
+        }
+        trace.size(result.size());
+        return result;
+    }
+    Collection Collection::find(const std::string& query) const
+    {
+        TraceScope trace("Collection::find", query);
+        Selector selector(query);
+        std::vector<Node*> found;
+        for (auto node: children_) {
+            for (Node* child = node->firstChild(); child; child = child->nextSibling()) {
+                selector.select(child, found);
+            }
+        }
+        if (children_.size() > 1) {
+            // Nested elements of the collection can find the same node twice:
+            Node::sortInDocumentOrder(found);
+        }
+        Collection result;
+        for (Node* node: found) {
+            result.push_back(node);
+        }
+        trace.size(result.size());
+        return result;
+    }
+    Collection Collection::add(const Collection& other) const
+    {
+        std::vector<Node*> nodes(children_);
+        nodes.insert(nodes.end(), other.children_.begin(), other.children_.end());
+        Node::sortInDocumentOrder(nodes);
+        Collection result;
+        for (Node* node: nodes) {
+            result.push_back(node);
+        }
+        return result;
+    }
+    Collection Collection::exclude(const Collection& other) const
+    {
+        std::unordered_set<Node*> excluded(other.children_.begin(), other.children_.end());
+        return filter([&](Node& node) { return excluded.count(&node) == 0; });
+    }
+    Collection Collection::exclude(const std::string& query) const
+    {
+        Selector selector(query);
+        return filter([&](Node& node) { return !selector.matches(node); });
+    }
+    bool Collection::is(const Collection& other) const
+    {
+        std::unordered_set<Node*> nodes(other.children_.begin(), other.children_.end());
+        for (Node* node: children_) {
+            if (nodes.count(node)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    bool Collection::is(const std::string& query) const
+    {
+        Selector selector(query);
+        for (Node* node: children_) {
+            if (selector.matches(*node)) {
+                return true;
+            }
+        }
+        return false;
+    }
     std::string Collection::attr(const std::string& key) const
     {
         if (children_.empty()) {
@@ -228,6 +415,27 @@ namespace SeeQuery
         return *this;
     }
 
+    AttributeValue Collection::attrValue(const std::string& key) const
+    {
+        if (children_.empty()) {
+            return AttributeValue();
+        }
+        return children_.front()->attrValue(key);
+    }
+    Collection& Collection::attr(const std::string& key, const AttributeValue& value)
+    {
+        for (auto node: children_) {
+            node->attr(key, value);
+        }
+        return *this;
+    }
+
+    Document* Collection::cacheDocument() const
+    {
+        // Only queries on a single element are cached; a document change
+        // makes them miss, as does the deletion of the element itself:
+        return children_.size() == 1 ? children_.front()->ownerDocument().get() : nullptr;
+    }
     void Collection::push_back(Node* node)
     {
         children_.push_back(node);
@@ -237,21 +445,25 @@ namespace SeeQuery
     /* Static methods: */
     size_t Collection::roots()
     {
-        return root_count.size();
+        return root_count;
     }
     void Collection::increment_root(Node* root)
     {
-        ++root_count[root];
+        if (root->root_refs_++ == 0) {
+            ++root_count;
+        }
     }
     void Collection::decrement_root(Node* root)
     {
         if (root->parent()) {
-            root_count.erase(root);
+            // The root has been embedded, its references now count for the new root:
+            if (root->root_refs_.exchange(0) > 0) {
+                --root_count;
+            }
             return;
         }
-        --root_count[root];
-        if (root_count[root] == 0) {
-            root_count.erase(root);
+        if (--root->root_refs_ == 0) {
+            --root_count;
             delete root;
         }
     }
@@ -263,16 +475,22 @@ namespace SeeQuery
         return node;
     }
 
-    std::unordered_map<Node*, int> Collection::root_count;
+    std::atomic<size_t> Collection::root_count(0);
 
-    SeeQuery::SeeQuery()
+    SeeQuery::SeeQuery() :
+        document_(std::make_shared<Document>())
+    {
+        push_back(new Dom(document_));
+    }
+    Document& SeeQuery::document() const
     {
-        push_back(new Dom);
+        return *document_;
     }
 
     std::ostream& operator<<(std::ostream& out, const Collection& collection)
     {
-        out << collection.serialize();
+        OStreamWriter writer(out);
+        collection.serialize(writer);
         return out;
     }
 }
\ No newline at end of file
@@ -2,26 +2,92 @@
 #define _COLLECTION_H
 
 #include <list>
+#include <vector>
+#include <utility>
+#include <unordered_map>
 #include <string>
 #include <memory>
 #include <sstream>
 #include <regex>
+#include <atomic>
+#include <stdexcept>
 #include "node.h"
 #include "text_node.h"
 #include "html_node.h"
 #include "dom.h"
+#include "document.h"
+#include "writer.h"
+#include "thread_pool.h"
 
 namespace SeeQuery
 {
+    template <class T> class DataJoin;
+
+    /** Bidirectional iterator over the elements of a collection */
+    class CollectionIterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef Node value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Node* pointer;
+        typedef Node& reference;
+
+        CollectionIterator() = default;
+        explicit CollectionIterator(std::vector<Node*>::const_iterator it) :
+            it_(it)
+        {}
+        reference operator*() const { return **it_; }
+        pointer operator->() const { return *it_; }
+        CollectionIterator& operator++()
+        {
+            ++it_;
+            return *this;
+        }
+        CollectionIterator operator++(int)
+        {
+            return CollectionIterator(it_++);
+        }
+        CollectionIterator& operator--()
+        {
+            --it_;
+            return *this;
+        }
+        CollectionIterator operator--(int)
+        {
+            return CollectionIterator(it_--);
+        }
+        bool operator==(const CollectionIterator& other) const { return it_ == other.it_; }
+        bool operator!=(const CollectionIterator& other) const { return it_ != other.it_; }
+    private:
+        std::vector<Node*>::const_iterator it_;
+    };
+
+    /**
+     * Concurrency model:
+     *
+     * - A document (a `SeeQuery` object, the nodes created through it and
+     *   the collections referring to them) may be used by one thread at a
+     *   time. Distinct documents share no mutable state and can be built,
+     *   queried and serialized on different threads in parallel.
+     * - A document that is no longer modified (frozen) can be queried and
+     *   serialized from many threads at once; root reference counts are
+     *   atomic, so the collections created by concurrent queries are safe.
+     * - Nodes must not be moved between documents used by different threads.
+     */
     class Collection
     {
     public:
+        typedef CollectionIterator iterator;
+        typedef CollectionIterator const_iterator;
+
         virtual ~Collection();
         Collection() = default;
         Collection(const Collection& other);
         Collection& operator=(const Collection& other);
 
         std::string serialize() const;
+        void serialize(Writer& out) const; /** Serialize all elements into `out` */
 
         Collection& append(const Collection& element);
         Collection& prepend(const Collection& element);
@@ -31,33 +97,210 @@ namespace SeeQuery
         Collection& remove();
 
         size_t size() const;
+        iterator begin() const; /** Iterate over the elements (the nodes, not collections) */
+        iterator end() const;
 
+        /**
+         * Create an element ('<tag/>') or query the elements. The results are
+         * in document order without duplicates, even for nested elements.
+         * Query results on a single element are cached until the document
+         * changes, see `Document::queryCache()`.
+         */
         Collection operator()(std::string selector, std::initializer_list<Attribute> attributes = {});
+        /**
+         * Run a '#id', 'tag' or '.class' query on `pool`, bypassing the
+         * query cache. The document must not be modified while the query
+         * runs. The result is the same, in the same order, as the one of the
+         * sequential query.
+         */
+        Collection operator()(const std::string& selector, ThreadPool& pool);
         Collection operator[](size_t index) const;
+        Node* get(size_t index) const; /** Get the element at `index`, null if out of range */
         Collection children() const;
+        Collection parent() const; /** Get the distinct parents of the elements */
+        Collection closest(const std::string& selector) const; /** Get the distinct nearest matching self-or-ancestors */
+        Collection find(const std::string& selector) const; /** Get the matching descendants of the elements */
+
+        Collection add(const Collection& other) const; /** Get the elements of both, in document order */
+        Collection exclude(const Collection& other) const; /** Get the elements not in `other` (jQuery `not()`) */
+        Collection exclude(const std::string& selector) const; /** Get the elements not matching `selector` */
+        bool is(const Collection& other) const; /** Return true if any element is in `other` */
+        bool is(const std::string& selector) const; /** Return true if any element matches `selector` */
+
+        /**
+         * Call `f(node)` for every element, in order. Unlike indexing, this
+         * creates no temporary collections.
+         */
+        template <class F>
+        Collection& each(F f)
+        {
+            for (Node* node: children_) {
+                f(*node);
+            }
+            return *this;
+        }
+        /** Get the results of `f(node)` for every element, in order */
+        template <class F>
+        auto map(F f) const -> std::vector<decltype(f(std::declval<Node&>()))>
+        {
+            std::vector<decltype(f(std::declval<Node&>()))> result;
+            result.reserve(children_.size());
+            for (Node* node: children_) {
+                result.push_back(f(*node));
+            }
+            return result;
+        }
+        /** Get the elements for which `predicate(node)` is true */
+        template <class F>
+        Collection filter(F predicate) const
+        {
+            Collection result;
+            for (Node* node: children_) {
+                if (predicate(*node)) {
+                    result.push_back(node);
+                }
+            }
+            return result;
+        }
 
         std::string attr(const std::string& key) const;
         Collection& attr(const std::string& key, const std::string& value);
+        AttributeValue attrValue(const std::string& key) const;
+        Collection& attr(const std::string& key, const AttributeValue& value);
+
+        /**
+         * Join `records` to the elements by key, in the manner of d3: the
+         * key of a record is `key(record)`, the key of an element is its
+         * `attribute`. Elements and records are matched through a hash map.
+         * See `DataJoin` for the resulting enter, update and exit sets.
+         */
+        template <class Container, class KeyOf>
+        DataJoin<typename Container::value_type> data(const Container& records, KeyOf key,
+            const std::string& attribute = "data-key") const;
 
         static size_t roots();
 
     protected:
         void push_back(Node* node);
+        friend class Template;
 
     private:
-        std::list<Node*> children_;
+        std::vector<Node*> children_;
+
+        Document* cacheDocument() const; /** Get the document whose query cache applies, null if none */
 
         /* Root reference count methods: */
         static void increment_root(Node* root);
         static void decrement_root(Node* root);
         static Node* get_root(Node* node);
-        static std::unordered_map<Node*, int> root_count;
+        static std::atomic<size_t> root_count; // number of referenced roots
     };
 
+    /**
+     * Result of `Collection::data()`: the records with no element (enter),
+     * the matched element and record pairs (update) and the elements with
+     * no record (exit). Records are referenced, not copied, and must
+     * outlive the join.
+     *
+     *     auto join = svg("rect").data(points, [](const Point& p) { return p.id; });
+     *     join.apply(svg,
+     *         [&](const Point& p) { return $("<rect/>"); }, // create
+     *         [](SeeQuery::Node& rect, const Point& p) { rect.attr("x", p.x); }); // update
+     */
+    template <class T>
+    class DataJoin
+    {
+    public:
+        struct Entering
+        {
+            const T* datum;
+            std::string key;
+        };
+        struct Updating
+        {
+            Node* node;
+            const T* datum;
+        };
+
+        const std::vector<Entering>& enter() const { return enter_; }
+        const std::vector<Updating>& update() const { return update_; }
+        Collection& exit() { return exit_; }
+
+        /**
+         * Remove the exit set, call `update(node, record)` on the update set,
+         * then append `create(record)` (a collection) to `parent` for every
+         * entering record, set its key attribute and `update()` it as well.
+         * `parent` must hold exactly one element, as appending to several
+         * would clone every entering element into each of them; otherwise
+         * `std::invalid_argument` is thrown before anything changes.
+         */
+        template <class Create, class Update>
+        void apply(Collection& parent, Create create, Update update)
+        {
+            if (parent.size() != 1) {
+                throw std::invalid_argument("DataJoin::apply: the parent must be a single element");
+            }
+            exit_.remove();
+            for (auto& entry: update_) {
+                update(*entry.node, *entry.datum);
+            }
+            for (auto& entry: enter_) {
+                Collection element = create(*entry.datum);
+                element.attr(attribute_, entry.key);
+                for (Node& node: element) {
+                    update(node, *entry.datum);
+                }
+                parent.append(element);
+            }
+        }
+
+    private:
+        friend class Collection;
+        std::string attribute_;
+        std::vector<Entering> enter_;
+        std::vector<Updating> update_;
+        Collection exit_;
+    };
+
+    template <class Container, class KeyOf>
+    DataJoin<typename Container::value_type> Collection::data(const Container& records, KeyOf key,
+        const std::string& attribute) const
+    {
+        DataJoin<typename Container::value_type> join;
+        join.attribute_ = attribute;
+        // Element of each key (the first one if repeated) and whether it is matched:
+        std::unordered_map<std::string, std::pair<Node*, bool>> elements;
+        elements.reserve(children_.size());
+        for (Node* node: children_) {
+            elements.insert(std::make_pair(node->attr(attribute), std::make_pair(node, false)));
+        }
+        for (auto& record: records) {
+            std::string record_key = AttributeValue(key(record)).str();
+            auto it = elements.find(record_key);
+            if (it != elements.end() && !it->second.second) {
+                join.update_.push_back({it->second.first, &record});
+                it->second.second = true;
+            } else {
+                // No element, or a repeated record key:
+                join.enter_.push_back({&record, std::move(record_key)});
+            }
+        }
+        for (Node* node: children_) {
+            auto& element = elements[node->attr(attribute)];
+            if (element.first != node || !element.second) {
+                join.exit_.push_back(node);
+            }
+        }
+        return join;
+    }
+
     class SeeQuery: public Collection
     {
     public:
         SeeQuery();
+        Document& document() const; /** Get the state shared by all nodes of this document */
+    private:
+        std::shared_ptr<Document> document_;
     };
 
     std::ostream& operator<<(std::ostream& out, const Collection& collection);
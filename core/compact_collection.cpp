@@ -0,0 +1,138 @@
+#include <unordered_set>
+#include "compact_collection.h"
+#include "selector.h"
+
+namespace SeeQuery
+{
+    CompactCollection::CompactCollection(const CompactDocument& document) :
+        document_(&document)
+    {
+        if (document.root() != CompactDocument::NONE) {
+            nodes_.push_back(document.root());
+        }
+    }
+    CompactCollection::CompactCollection(const CompactDocument& document, std::vector<NodeId> nodes) :
+        document_(&document),
+        nodes_(std::move(nodes))
+    {}
+    const CompactDocument& CompactCollection::document() const
+    {
+        return *document_;
+    }
+    std::string CompactCollection::serialize() const
+    {
+        std::string out;
+        for (NodeId node: nodes_) {
+            out += document_->serialize(node);
+            out += '\n';
+        }
+        return out;
+    }
+    size_t CompactCollection::size() const
+    {
+        return nodes_.size();
+    }
+    CompactCollection::iterator CompactCollection::begin() const
+    {
+        return nodes_.begin();
+    }
+    CompactCollection::iterator CompactCollection::end() const
+    {
+        return nodes_.end();
+    }
+    CompactCollection CompactCollection::operator()(const std::string& query) const
+    {
+        if (query.empty()) {
+            return *this;
+        }
+        Selector selector(query);
+        std::vector<NodeId> found;
+        for (NodeId node: nodes_) {
+            select(selector, node, found);
+        }
+        if (nodes_.size() > 1) {
+            // Nested elements find the same nodes, and in another order:
+            document_->sortInDocumentOrder(found);
+        }
+        return CompactCollection(*document_, std::move(found));
+    }
+    CompactCollection CompactCollection::operator[](size_t index) const
+    {
+        std::vector<NodeId> nodes;
+        if (index < nodes_.size()) {
+            nodes.push_back(nodes_[index]);
+        }
+        return CompactCollection(*document_, std::move(nodes));
+    }
+    CompactCollection::NodeId CompactCollection::get(size_t index) const
+    {
+        return index < nodes_.size() ? nodes_[index] : CompactDocument::NONE;
+    }
+    CompactCollection CompactCollection::children() const
+    {
+        std::vector<NodeId> nodes;
+        for (NodeId node: nodes_) {
+            for (NodeId child = document_->firstChild(node); child != CompactDocument::NONE;
+                    child = document_->nextSibling(child)) {
+                nodes.push_back(child);
+            }
+        }
+        return CompactCollection(*document_, std::move(nodes));
+    }
+    CompactCollection CompactCollection::parent() const
+    {
+        std::vector<NodeId> nodes;
+        std::unordered_set<NodeId> seen;
+        for (NodeId node: nodes_) {
+            NodeId parent = document_->parent(node);
+            if (parent != CompactDocument::NONE && seen.insert(parent).second) {
+                nodes.push_back(parent);
+            }
+        }
+        return CompactCollection(*document_, std::move(nodes));
+    }
+    CompactCollection CompactCollection::find(const std::string& query) const
+    {
+        Selector selector(query);
+        std::vector<NodeId> found;
+        for (NodeId node: nodes_) {
+            for (NodeId child = document_->firstChild(node); child != CompactDocument::NONE;
+                    child = document_->nextSibling(child)) {
+                select(selector, child, found);
+            }
+        }
+        if (nodes_.size() > 1) {
+            // Nested elements of the collection can find the same node twice:
+            document_->sortInDocumentOrder(found);
+        }
+        return CompactCollection(*document_, std::move(found));
+    }
+    std::string CompactCollection::attr(const std::string& key) const
+    {
+        if (nodes_.empty()) {
+            return std::string();
+        }
+        return document_->attr(nodes_.front(), key);
+    }
+    void CompactCollection::select(const Selector& selector, NodeId root, std::vector<NodeId>& out) const
+    {
+        std::vector<NodeId> nodes;
+        switch (selector.type()) {
+        case Selector::ID:
+            nodes.push_back(document_->getElementById(root, selector.value()));
+            if (nodes.back() == CompactDocument::NONE) {
+                nodes.pop_back();
+            }
+            break;
+        case Selector::TAG:
+            nodes = document_->getElementsByTagName(root, selector.value());
+            break;
+        case Selector::CLASS:
+            nodes = document_->getElementsByClassName(root, selector.value());
+            break;
+        default:
+            break;
+        }
+        out.insert(out.end(), nodes.begin(), nodes.end());
+    }
+}
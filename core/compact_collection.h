@@ -0,0 +1,67 @@
+#ifndef _COMPACT_COLLECTION_H
+#define _COMPACT_COLLECTION_H
+
+#include <string>
+#include <vector>
+#include "compact_document.h"
+
+namespace SeeQuery
+{
+    class Selector;
+
+    /**
+     * Read-only `Collection` over a `CompactDocument`: the same queries,
+     * traversals and output on node ids, so a large document can be queried
+     * without materializing a `Node` tree.
+     *
+     *     CompactDocument document(*root);
+     *     CompactCollection $(document);
+     *     for (auto rect: $("svg")(".bar")) {
+     *         std::cout << document.attr(rect, "x") << std::endl;
+     *     }
+     *
+     * A collection refers to its document, which must outlive it. As with
+     * `Collection`, a document that is no longer modified can be queried
+     * from several threads at once.
+     */
+    class CompactCollection
+    {
+    public:
+        typedef CompactDocument::NodeId NodeId;
+        typedef std::vector<NodeId>::const_iterator iterator;
+        typedef iterator const_iterator;
+
+        explicit CompactCollection(const CompactDocument& document); /** Select the root of `document`, if any */
+        CompactCollection(const CompactDocument& document, std::vector<NodeId> nodes);
+
+        const CompactDocument& document() const;
+        std::string serialize() const;
+
+        size_t size() const;
+        iterator begin() const; /** Iterate over the node ids */
+        iterator end() const;
+
+        /**
+         * Query the elements as `Collection::operator()`: '#id', 'tag' or
+         * '.class' matches within their subtrees, in document order without
+         * duplicates. Elements cannot be created ('<tag/>' gives an empty
+         * collection).
+         */
+        CompactCollection operator()(const std::string& selector) const;
+        CompactCollection operator[](size_t index) const;
+        NodeId get(size_t index) const; /** Get the id at `index`, `CompactDocument::NONE` if out of range */
+        CompactCollection children() const;
+        CompactCollection parent() const; /** Get the distinct parents of the elements */
+        CompactCollection find(const std::string& selector) const; /** Get the matching descendants of the elements */
+
+        std::string attr(const std::string& key) const; /** Get attribute `key` of the first element */
+
+    private:
+        void select(const Selector& selector, NodeId root, std::vector<NodeId>& out) const;
+
+        const CompactDocument* document_;
+        std::vector<NodeId> nodes_;
+    };
+}
+
+#endif // _COMPACT_COLLECTION_H
@@ -0,0 +1,434 @@
+#include <stdexcept>
+#include <unordered_set>
+#include "compact_document.h"
+#include "text_node.h"
+#include "dom.h"
+
+namespace SeeQuery
+{
+    constexpr CompactDocument::NodeId CompactDocument::NONE;
+    constexpr uint32_t CompactDocument::TEXT_FLAG;
+
+    namespace
+    {
+        void check_size(size_t size, size_t limit, const char* what)
+        {
+            if (size >= limit) {
+                throw std::length_error(std::string("CompactDocument: too many ") + what);
+            }
+        }
+    }
+
+    CompactDocument::CompactDocument(const Node& root)
+    {
+        import(root);
+    }
+    CompactDocument::NodeId CompactDocument::createNode(uint32_t name)
+    {
+        check_size(name_.size(), NONE, "nodes");
+        NodeId id = static_cast<NodeId>(name_.size());
+        parent_.push_back(NONE);
+        first_child_.push_back(NONE);
+        last_child_.push_back(NONE);
+        next_sibling_.push_back(NONE);
+        name_.push_back(name);
+        attr_begin_.push_back(static_cast<uint32_t>(attributes_.size()));
+        attr_count_.push_back(0);
+        return id;
+    }
+    CompactDocument::NodeId CompactDocument::createElement(const std::string& tag_name,
+        std::initializer_list<Attribute> attributes)
+    {
+        NodeId id = createNode(atom(tag_name));
+        for (auto& attribute: attributes) {
+            if (attribute.key == "text") {
+                link(id, createText(attribute.value.str()));
+            } else {
+                attr(id, attribute.key, attribute.value.str());
+            }
+        }
+        return id;
+    }
+    CompactDocument::NodeId CompactDocument::createText(const std::string& text)
+    {
+        return createNode(addString(text) | TEXT_FLAG);
+    }
+    CompactDocument::NodeId CompactDocument::import(const Node& root)
+    {
+        NodeId id;
+        if (root.nodeType() == Node::TEXT_NODE) {
+            id = createText(root.text());
+        } else {
+            auto& element = static_cast<const HtmlNode&>(root);
+            id = createNode(atom(element.tagName()));
+            if (auto dom = dynamic_cast<const Dom*>(&root)) {
+                if (id == 0) {
+                    doctype_ = dom->doctype();
+                }
+            }
+            for (auto& attribute: element.attributes()) {
+                addAttribute(id, atom(attribute.first), addString(attribute.second.str()));
+            }
+        }
+        // Children are imported right after their parent, so ids follow document order:
+        for (Node* child = root.firstChild(); child; child = child->nextSibling()) {
+            link(id, import(*child));
+        }
+        return id;
+    }
+    void CompactDocument::append(NodeId parent, NodeId child)
+    {
+        check(parent);
+        check(child);
+        if (parent_[child] != NONE) {
+            throw std::invalid_argument("CompactDocument::append: the child is not detached");
+        }
+        for (NodeId node = parent; node != NONE; node = parent_[node]) {
+            if (node == child) {
+                throw std::invalid_argument("CompactDocument::append: the child is the parent or one of its ancestors");
+            }
+        }
+        link(parent, child);
+    }
+    void CompactDocument::link(NodeId parent, NodeId child)
+    {
+        parent_[child] = parent;
+        if (last_child_[parent] == NONE) {
+            first_child_[parent] = child;
+        } else {
+            next_sibling_[last_child_[parent]] = child;
+        }
+        last_child_[parent] = child;
+    }
+    size_t CompactDocument::size() const
+    {
+        return name_.size();
+    }
+    CompactDocument::NodeId CompactDocument::root() const
+    {
+        return name_.empty() ? NONE : 0;
+    }
+    const std::string& CompactDocument::doctype() const
+    {
+        return doctype_;
+    }
+    int CompactDocument::nodeType(NodeId node) const
+    {
+        check(node);
+        return (name_[node] & TEXT_FLAG) ? Node::TEXT_NODE : Node::ELEMENT_NODE;
+    }
+    CompactDocument::NodeId CompactDocument::parent(NodeId node) const
+    {
+        check(node);
+        return parent_[node];
+    }
+    CompactDocument::NodeId CompactDocument::firstChild(NodeId node) const
+    {
+        check(node);
+        return first_child_[node];
+    }
+    CompactDocument::NodeId CompactDocument::lastChild(NodeId node) const
+    {
+        check(node);
+        return last_child_[node];
+    }
+    CompactDocument::NodeId CompactDocument::nextSibling(NodeId node) const
+    {
+        check(node);
+        return next_sibling_[node];
+    }
+    std::string CompactDocument::tagName(NodeId node) const
+    {
+        check(node);
+        if (name_[node] & TEXT_FLAG) {
+            return std::string();
+        }
+        return atoms_[name_[node]];
+    }
+    std::string CompactDocument::text(NodeId node) const
+    {
+        check(node);
+        if (name_[node] & TEXT_FLAG) {
+            return str(name_[node] & ~TEXT_FLAG);
+        }
+        return std::string();
+    }
+    std::string CompactDocument::attr(NodeId node, const std::string& key) const
+    {
+        check(node);
+        uint32_t key_atom = findAtom(key);
+        if (key_atom == NONE) {
+            return std::string();
+        }
+        for (uint32_t i = attr_begin_[node]; i < attr_begin_[node] + attr_count_[node]; ++i) {
+            if (attributes_[i].key == key_atom) {
+                return str(attributes_[i].value);
+            }
+        }
+        return std::string();
+    }
+    void CompactDocument::attr(NodeId node, const std::string& key, const std::string& value)
+    {
+        check(node);
+        if (name_[node] & TEXT_FLAG) {
+            return; // text nodes have no attributes
+        }
+        uint32_t key_atom = atom(key);
+        uint32_t begin = attr_begin_[node];
+        uint32_t end = begin + attr_count_[node];
+        for (uint32_t i = begin; i < end; ++i) {
+            if (attributes_[i].key == key_atom) {
+                attributes_[i].value = addString(value);
+                return;
+            }
+        }
+        uint32_t value_id = addString(value);
+        if (end != attributes_.size()) {
+            // The range is not at the end of the table, move it there to grow it:
+            check_size(attributes_.size() + attr_count_[node], NONE, "attributes");
+            attr_begin_[node] = static_cast<uint32_t>(attributes_.size());
+            for (uint32_t i = begin; i < end; ++i) {
+                attributes_.push_back(attributes_[i]);
+            }
+        }
+        addAttribute(node, key_atom, value_id);
+    }
+    void CompactDocument::addAttribute(NodeId node, uint32_t key, uint32_t value)
+    {
+        check_size(attributes_.size(), NONE, "attributes");
+        attributes_.push_back(AttributeEntry{key, value});
+        ++attr_count_[node];
+    }
+    CompactDocument::NodeId CompactDocument::nextInSubtree(NodeId root, NodeId node, bool descend) const
+    {
+        if (descend && first_child_[node] != NONE) {
+            return first_child_[node];
+        }
+        while (node != root) {
+            if (next_sibling_[node] != NONE) {
+                return next_sibling_[node];
+            }
+            node = parent_[node];
+        }
+        return NONE;
+    }
+    void CompactDocument::sortInDocumentOrder(std::vector<NodeId>& nodes) const
+    {
+        if (nodes.size() < 2) {
+            return;
+        }
+        // Walk the trees of the nodes, in the order they first appear, and
+        // collect the nodes as they come:
+        std::unordered_set<NodeId> wanted(nodes.begin(), nodes.end());
+        std::vector<NodeId> tops;
+        std::unordered_set<NodeId> seen;
+        for (NodeId node: nodes) {
+            check(node);
+            while (parent_[node] != NONE) {
+                node = parent_[node];
+            }
+            if (seen.insert(node).second) {
+                tops.push_back(node);
+            }
+        }
+        nodes.clear();
+        for (NodeId top: tops) {
+            NodeId node = top;
+            for (; node != NONE && nodes.size() < wanted.size(); node = nextInSubtree(top, node, true)) {
+                if (wanted.count(node)) {
+                    nodes.push_back(node);
+                }
+            }
+        }
+    }
+    CompactDocument::NodeId CompactDocument::getElementById(NodeId root, const std::string& id) const
+    {
+        check(root);
+        uint32_t key_atom = findAtom("id");
+        if (key_atom == NONE) {
+            return NONE;
+        }
+        for (NodeId node = root; node != NONE; node = nextInSubtree(root, node, true)) {
+            for (uint32_t i = attr_begin_[node]; i < attr_begin_[node] + attr_count_[node]; ++i) {
+                if (attributes_[i].key == key_atom && stringEquals(attributes_[i].value, id)) {
+                    return node;
+                }
+            }
+        }
+        return NONE;
+    }
+    std::vector<CompactDocument::NodeId> CompactDocument::getElementsByTagName(NodeId root,
+        const std::string& tag_name) const
+    {
+        check(root);
+        std::vector<NodeId> result;
+        uint32_t tag_atom = findAtom(tag_name);
+        if (tag_atom == NONE) {
+            return result;
+        }
+        NodeId node = root;
+        while (node != NONE) {
+            // As `HtmlNode`, do not descend into matching elements:
+            bool match = name_[node] == tag_atom;
+            if (match) {
+                result.push_back(node);
+            }
+            node = nextInSubtree(root, node, !match);
+        }
+        return result;
+    }
+    std::vector<CompactDocument::NodeId> CompactDocument::getElementsByClassName(NodeId root,
+        const std::string& class_name) const
+    {
+        check(root);
+        std::vector<NodeId> result;
+        uint32_t key_atom = findAtom("class");
+        if (key_atom == NONE) {
+            return result;
+        }
+        NodeId node = root;
+        while (node != NONE) {
+            bool match = false;
+            for (uint32_t i = attr_begin_[node]; i < attr_begin_[node] + attr_count_[node]; ++i) {
+                if (attributes_[i].key == key_atom) {
+                    uint32_t value = attributes_[i].value;
+                    match = ClassList::contains(chars_.data() + string_offsets_[value],
+                        string_offsets_[value + 1] - string_offsets_[value], class_name);
+                    break;
+                }
+            }
+            if (match) {
+                result.push_back(node);
+            }
+            node = nextInSubtree(root, node, !match);
+        }
+        return result;
+    }
+    std::string CompactDocument::serialize(NodeId node, size_t depth) const
+    {
+        check(node);
+        std::string out;
+        if (node == root() && !doctype_.empty()) {
+            out += doctype_;
+            out += '\n';
+        }
+        serialize(node, depth, out);
+        return out;
+    }
+    void CompactDocument::serialize(NodeId node, size_t depth, std::string& out) const
+    {
+        out.append(depth * INDENT_WIDTH, ' ');
+        if (name_[node] & TEXT_FLAG) {
+            uint32_t id = name_[node] & ~TEXT_FLAG;
+            out.append(chars_, string_offsets_[id], string_offsets_[id + 1] - string_offsets_[id]);
+            return;
+        }
+        const std::string& tag_name = atoms_[name_[node]];
+        out += '<';
+        out += tag_name;
+        for (uint32_t i = attr_begin_[node]; i < attr_begin_[node] + attr_count_[node]; ++i) {
+            uint32_t value = attributes_[i].value;
+            out += ' ';
+            out += atoms_[attributes_[i].key];
+            out += "=\"";
+            out.append(chars_, string_offsets_[value], string_offsets_[value + 1] - string_offsets_[value]);
+            out += '"';
+        }
+        if (first_child_[node] == NONE) {
+            out += "/>";
+            return;
+        }
+        out += ">\n";
+        for (NodeId child = first_child_[node]; child != NONE; child = next_sibling_[child]) {
+            serialize(child, depth + 1, out);
+            out += '\n';
+        }
+        out.append(depth * INDENT_WIDTH, ' ');
+        out += "</";
+        out += tag_name;
+        out += '>';
+    }
+    Node* CompactDocument::toNode(NodeId node) const
+    {
+        check(node);
+        if (name_[node] & TEXT_FLAG) {
+            return new TextNode(text(node));
+        }
+        HtmlNode* element;
+        if (node == root() && !doctype_.empty()) {
+            element = new Dom();
+            while (Node* child = element->firstChild()) {
+                delete child->detach(); // the imported head and body replace the default ones
+            }
+        } else {
+            element = new HtmlNode(atoms_[name_[node]]);
+        }
+        for (uint32_t i = attr_begin_[node]; i < attr_begin_[node] + attr_count_[node]; ++i) {
+            element->attr(atoms_[attributes_[i].key], str(attributes_[i].value));
+        }
+        for (NodeId child = first_child_[node]; child != NONE; child = next_sibling_[child]) {
+            element->append(toNode(child));
+        }
+        return element;
+    }
+    size_t CompactDocument::memoryUsage() const
+    {
+        size_t bytes = sizeof(*this)
+            + (parent_.capacity() + first_child_.capacity() + last_child_.capacity()
+                + next_sibling_.capacity()) * sizeof(NodeId)
+            + (name_.capacity() + attr_begin_.capacity() + attr_count_.capacity()) * sizeof(uint32_t)
+            + attributes_.capacity() * sizeof(AttributeEntry)
+            + string_offsets_.capacity() * sizeof(uint32_t)
+            + chars_.capacity()
+            + atoms_.capacity() * sizeof(std::string);
+        for (auto& a: atoms_) {
+            // Each atom is stored twice: in `atoms_` and as a key of `atom_ids_`:
+            bytes += 2 * a.capacity();
+        }
+        return bytes;
+    }
+    void CompactDocument::check(NodeId node) const
+    {
+        if (node >= name_.size()) {
+            throw std::invalid_argument("CompactDocument: no node " + std::to_string(node));
+        }
+    }
+    uint32_t CompactDocument::atom(const std::string& s)
+    {
+        auto it = atom_ids_.find(s);
+        if (it != atom_ids_.end()) {
+            return it->second;
+        }
+        check_size(atoms_.size(), TEXT_FLAG, "atoms");
+        uint32_t id = static_cast<uint32_t>(atoms_.size());
+        atoms_.push_back(s);
+        atom_ids_.emplace(s, id);
+        return id;
+    }
+    uint32_t CompactDocument::findAtom(const std::string& s) const
+    {
+        auto it = atom_ids_.find(s);
+        return it == atom_ids_.end() ? NONE : it->second;
+    }
+    uint32_t CompactDocument::addString(const std::string& s)
+    {
+        // Text nodes store string ids with `TEXT_FLAG`, so ids must stay below it:
+        check_size(string_offsets_.size() - 1, TEXT_FLAG, "strings");
+        if (s.size() > UINT32_MAX - chars_.size()) {
+            throw std::length_error("CompactDocument: more than 4 GiB of characters");
+        }
+        uint32_t id = static_cast<uint32_t>(string_offsets_.size() - 1);
+        chars_ += s;
+        string_offsets_.push_back(static_cast<uint32_t>(chars_.size()));
+        return id;
+    }
+    std::string CompactDocument::str(uint32_t id) const
+    {
+        return chars_.substr(string_offsets_[id], string_offsets_[id + 1] - string_offsets_[id]);
+    }
+    bool CompactDocument::stringEquals(uint32_t id, const std::string& s) const
+    {
+        size_t length = string_offsets_[id + 1] - string_offsets_[id];
+        return length == s.size() && chars_.compare(string_offsets_[id], length, s) == 0;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef _COMPACT_DOCUMENT_H
+#define _COMPACT_DOCUMENT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "node.h"
+#include "html_node.h"
+
+namespace SeeQuery
+{
+    /**
+     * Data-oriented document storage.
+     *
+     * Nodes are identified by 32-bit ids and the tree topology is kept in
+     * parallel arrays, so a node costs a few dozen bytes instead of a heap
+     * object with a vtable, pointers and an attribute map. Tag names and
+     * attribute keys are interned as atoms; attributes of a node are a
+     * contiguous range of (key atom, value) pairs in a side table and all
+     * strings live in one character buffer.
+     *
+     * The storage is append-only: updating an attribute writes the new value
+     * to the end of the character buffer. It has its own id-based API, and
+     * `CompactCollection` runs the queries of `Collection` on it without a
+     * `Node` tree. A document can also be imported from and converted back to
+     * a `Node` tree, but the converted tree takes the memory of a `Node` tree
+     * again.
+     *
+     * Ids, offsets and counts are 32-bit; growing past them throws
+     * `std::length_error`. Passing an id that is not a node of the document
+     * throws `std::invalid_argument`.
+     */
+    class CompactDocument
+    {
+    public:
+        typedef uint32_t NodeId;
+        static constexpr NodeId NONE = 0xffffffff;
+
+        CompactDocument() = default;
+        explicit CompactDocument(const Node& root); /** Import `root` and its subtree in document order */
+
+        NodeId createElement(const std::string& tag_name, std::initializer_list<Attribute> attributes = {});
+        NodeId createText(const std::string& text);
+        NodeId import(const Node& root); /** Copy `root` and its subtree, return id of the copy */
+        /** Append detached node `child` to `parent`; throws `std::invalid_argument` if attached or an ancestor */
+        void append(NodeId parent, NodeId child);
+
+        size_t size() const; /** Get the number of nodes */
+        NodeId root() const; /** Get the first created node, `NONE` if empty */
+        const std::string& doctype() const; /** Get the doctype of an imported `Dom`, empty if none */
+
+        int nodeType(NodeId node) const;
+        NodeId parent(NodeId node) const;
+        NodeId firstChild(NodeId node) const;
+        NodeId lastChild(NodeId node) const;
+        NodeId nextSibling(NodeId node) const;
+
+        std::string tagName(NodeId node) const;
+        std::string text(NodeId node) const; /** Get text of a text node */
+        std::string attr(NodeId node, const std::string& key) const;
+        void attr(NodeId node, const std::string& key, const std::string& value);
+
+        /** Sort `nodes` in document order and drop duplicates, in a pass over their trees */
+        void sortInDocumentOrder(std::vector<NodeId>& nodes) const;
+
+        NodeId getElementById(NodeId root, const std::string& id) const;
+        std::vector<NodeId> getElementsByTagName(NodeId root, const std::string& tag_name) const;
+        std::vector<NodeId> getElementsByClassName(NodeId root, const std::string& class_name) const;
+
+        std::string serialize(NodeId node, size_t depth = 0) const; /** Serialize, with the doctype for the root */
+        Node* toNode(NodeId node) const; /** Materialize a heap `Node` tree (a `Dom` for a root with a doctype) */
+
+        size_t memoryUsage() const; /** Get approximate number of bytes held by the storage */
+
+    private:
+        struct AttributeEntry
+        {
+            uint32_t key; // atom
+            uint32_t value; // string id
+        };
+
+        static constexpr uint32_t TEXT_FLAG = 0x80000000; // string ids and atoms stay below it
+
+        void check(NodeId node) const; /** Throw `std::invalid_argument` unless `node` is a node of this document */
+        void link(NodeId parent, NodeId child); /** Append `child` to `parent`, unchecked */
+        NodeId createNode(uint32_t name);
+        uint32_t atom(const std::string& s);
+        uint32_t findAtom(const std::string& s) const; /** Return `NONE` if `s` was never interned */
+        uint32_t addString(const std::string& s);
+        std::string str(uint32_t id) const;
+        bool stringEquals(uint32_t id, const std::string& s) const;
+        void addAttribute(NodeId node, uint32_t key, uint32_t value); /** Append to the attribute table */
+        NodeId nextInSubtree(NodeId root, NodeId node, bool descend) const;
+        void serialize(NodeId node, size_t depth, std::string& out) const;
+
+        /* Topology, indexed by node id: */
+        std::vector<NodeId> parent_;
+        std::vector<NodeId> first_child_;
+        std::vector<NodeId> last_child_;
+        std::vector<NodeId> next_sibling_;
+        std::vector<uint32_t> name_; // tag atom, or string id | TEXT_FLAG for text nodes
+        std::vector<uint32_t> attr_begin_;
+        std::vector<uint32_t> attr_count_;
+
+        /* Side tables: */
+        std::vector<AttributeEntry> attributes_;
+        std::vector<std::string> atoms_;
+        std::unordered_map<std::string, uint32_t> atom_ids_;
+        std::vector<uint32_t> string_offsets_{0}; // string `i` is [offsets[i], offsets[i + 1])
+        std::string chars_;
+        std::string doctype_;
+    };
+}
+
+#endif // _COMPACT_DOCUMENT_H
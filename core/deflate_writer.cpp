@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "deflate_writer.h"
+
+namespace SeeQuery
+{
+    DeflateWriter::DeflateWriter(Writer& out, int level, Format format, size_t chunk_size) :
+        out_(out),
+        input_(chunk_size),
+        output_(chunk_size)
+    {
+        std::memset(&stream_, 0, sizeof(stream_));
+        int window_bits = format == GZIP ? 15 + 16 : format == RAW ? -15 : 15;
+        if (deflateInit2(&stream_, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("deflateInit2 failed");
+        }
+    }
+    DeflateWriter::~DeflateWriter()
+    {
+        try {
+            finish();
+        } catch (const std::exception&) {
+            // Destructors must not throw.
+        }
+        deflateEnd(&stream_);
+    }
+    void DeflateWriter::write(const char* data, size_t size)
+    {
+        if (finished_) {
+            throw std::runtime_error("write to a finished deflate stream");
+        }
+        bytes_in_ += size;
+        // Small pieces are gathered into chunks, so that zlib is not called per piece:
+        while (size > 0) {
+            size_t n = std::min(size, input_.size() - input_used_);
+            std::memcpy(input_.data() + input_used_, data, n);
+            input_used_ += n;
+            data += n;
+            size -= n;
+            if (input_used_ == input_.size()) {
+                deflate(Z_NO_FLUSH);
+            }
+        }
+    }
+    void DeflateWriter::flush()
+    {
+        if (!finished_) {
+            deflate(Z_SYNC_FLUSH);
+        }
+        out_.flush();
+    }
+    void DeflateWriter::finish()
+    {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+        deflate(Z_FINISH);
+        out_.flush();
+    }
+    void DeflateWriter::deflate(int mode)
+    {
+        stream_.next_in = reinterpret_cast<Bytef*>(input_.data());
+        stream_.avail_in = static_cast<uInt>(input_used_);
+        do {
+            stream_.next_out = reinterpret_cast<Bytef*>(output_.data());
+            stream_.avail_out = static_cast<uInt>(output_.size());
+            int status = ::deflate(&stream_, mode);
+            if (status == Z_STREAM_ERROR) {
+                throw std::runtime_error("deflate failed");
+            }
+            size_t produced = output_.size() - stream_.avail_out;
+            if (produced > 0) {
+                out_.write(output_.data(), produced);
+            }
+        } while (stream_.avail_out == 0);
+        input_used_ = 0;
+    }
+    size_t DeflateWriter::bytesIn() const
+    {
+        return bytes_in_;
+    }
+    size_t DeflateWriter::bytesOut() const
+    {
+        return stream_.total_out;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef _DEFLATE_WRITER_H
+#define _DEFLATE_WRITER_H
+
+#include <vector>
+#include <zlib.h>
+#include "writer.h"
+
+namespace SeeQuery
+{
+    /**
+     * Writer compressing the output on the fly and passing it to another
+     * writer, e.g. an `FdWriter`.
+     *
+     * Input is deflated chunk by chunk as the serializer produces it, so
+     * neither the plain nor the compressed document is ever held in memory
+     * as a whole. `finish()` (or the destructor) writes the stream trailer.
+     *
+     * Compression errors are reported as `std::runtime_error`.
+     */
+    class DeflateWriter: public Writer
+    {
+    public:
+        using Writer::write;
+        using Writer::writeRef;
+
+        enum Format {
+            GZIP, // gzip header and trailer (RFC 1952)
+            ZLIB, // zlib wrapper (RFC 1950)
+            RAW // raw deflate (RFC 1951)
+        };
+
+        explicit DeflateWriter(Writer& out, int level = Z_DEFAULT_COMPRESSION,
+            Format format = GZIP, size_t chunk_size = 64 * 1024);
+        ~DeflateWriter(); /** Finish the stream, ignoring errors; call `finish()` to see them */
+        DeflateWriter(const DeflateWriter&) = delete;
+        DeflateWriter& operator=(const DeflateWriter&) = delete;
+
+        void write(const char* data, size_t size);
+        void flush(); /** Compress pending input so that it can be decoded, then flush `out` */
+        void finish(); /** Compress pending input, write the trailer and flush `out` */
+
+        size_t bytesIn() const; /** Get the number of uncompressed bytes written */
+        size_t bytesOut() const; /** Get the number of compressed bytes produced */
+    private:
+        void deflate(int mode);
+
+        Writer& out_;
+        z_stream stream_;
+        std::vector<char> input_;
+        size_t input_used_ = 0;
+        std::vector<char> output_;
+        size_t bytes_in_ = 0;
+        bool finished_ = false;
+    };
+}
+
+#endif // _DEFLATE_WRITER_H
@@ -0,0 +1,144 @@
+#include "document.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        /* Bytes of an id entry besides the id and the elements: the hash table node (entry, link and cached hash): */
+        const size_t ID_OVERHEAD = sizeof(std::pair<const std::string, std::vector<Node*>>) + 2 * sizeof(void*);
+    }
+
+    constexpr size_t Document::MAX_INTERNED_TEXT;
+
+    void Document::internStrings(bool enable)
+    {
+        intern_strings_ = enable;
+    }
+    bool Document::internsStrings() const
+    {
+        return intern_strings_;
+    }
+    StringPool& Document::stringPool()
+    {
+        return pool_;
+    }
+    ClassTable& Document::classTable()
+    {
+        return class_table_;
+    }
+    const ClassTable& Document::classTable() const
+    {
+        return class_table_;
+    }
+    void Document::addId(const std::string& id, Node* element)
+    {
+        auto inserted = ids_.insert(std::make_pair(id, std::vector<Node*>()));
+        size_t old_bytes = inserted.second ? 0 : ID_OVERHEAD + id.size() + inserted.first->second.capacity() * sizeof(Node*);
+        inserted.first->second.push_back(element);
+        memory_.adjust(MemoryAccount::DOCUMENT, old_bytes,
+            ID_OVERHEAD + id.size() + inserted.first->second.capacity() * sizeof(Node*));
+    }
+    void Document::removeId(const std::string& id, Node* element)
+    {
+        auto it = ids_.find(id);
+        if (it == ids_.end()) {
+            return;
+        }
+        auto& elements = it->second;
+        for (size_t i = 0; i < elements.size(); ++i) {
+            if (elements[i] == element) {
+                elements[i] = elements.back();
+                elements.pop_back();
+                break;
+            }
+        }
+        if (elements.empty()) {
+            memory_.release(MemoryAccount::DOCUMENT, ID_OVERHEAD + id.size() + elements.capacity() * sizeof(Node*));
+            ids_.erase(it);
+        }
+    }
+    const std::vector<Node*>& Document::elementsById(const std::string& id) const
+    {
+        static const std::vector<Node*> none;
+        auto it = ids_.find(id);
+        return it != ids_.end() ? it->second : none;
+    }
+    ChildIndex* Document::childIndex(const Node* parent) const
+    {
+        auto it = child_indexes_.find(parent);
+        return it != child_indexes_.end() ? it->second.get() : nullptr;
+    }
+    void Document::childIndex(const Node* parent, std::unique_ptr<ChildIndex> index)
+    {
+        std::unique_ptr<ChildIndex> previous = releaseChildIndex(parent);
+        if (index) {
+            memory_.adjust(MemoryAccount::DOCUMENT, 0, index->bytes());
+            child_indexes_[parent] = std::move(index);
+        }
+    }
+    std::unique_ptr<ChildIndex> Document::releaseChildIndex(const Node* parent)
+    {
+        std::unique_ptr<ChildIndex> index;
+        auto it = child_indexes_.find(parent);
+        if (it != child_indexes_.end()) {
+            index = std::move(it->second);
+            child_indexes_.erase(it);
+            memory_.release(MemoryAccount::DOCUMENT, index->bytes());
+        }
+        return index;
+    }
+    StringPool::Handle Document::intern(const std::string& s)
+    {
+        if (intern_strings_) {
+            return pool_.intern(s);
+        }
+        return std::make_shared<const std::string>(s);
+    }
+    StringPool::Handle Document::internText(const std::string& text)
+    {
+        if (intern_strings_ && text.size() <= MAX_INTERNED_TEXT) {
+            return pool_.intern(text);
+        }
+        return std::make_shared<const std::string>(text);
+    }
+    AttributeValue Document::intern(const AttributeValue& value)
+    {
+        if (!intern_strings_ || value.isNumber()) {
+            return value;
+        }
+        return AttributeValue(pool_.intern(*value.string()));
+    }
+    Journal& Document::startJournal(size_t capacity)
+    {
+        journal_.reset(new Journal(capacity, &memory_));
+        return *journal_;
+    }
+    void Document::stopJournal()
+    {
+        journal_.reset();
+    }
+    Journal* Document::journal() const
+    {
+        return journal_.get();
+    }
+    uint64_t Document::generation() const
+    {
+        return generation_.load(std::memory_order_relaxed);
+    }
+    void Document::touch()
+    {
+        generation_.fetch_add(1, std::memory_order_relaxed);
+    }
+    QueryCache& Document::queryCache()
+    {
+        return query_cache_;
+    }
+    MemoryAccount& Document::memory()
+    {
+        return memory_;
+    }
+    const MemoryAccount& Document::memory() const
+    {
+        return memory_;
+    }
+}
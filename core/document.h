@@ -0,0 +1,82 @@
+#ifndef _DOCUMENT_H
+#define _DOCUMENT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include "string_pool.h"
+#include "attribute_value.h"
+#include "journal.h"
+#include "query_cache.h"
+#include "memory_account.h"
+#include "class_list.h"
+#include "child_index.h"
+
+namespace SeeQuery
+{
+    class Node;
+
+    /**
+     * State shared by all nodes of one document.
+     *
+     * Every node created through a `SeeQuery` document points to its
+     * `Document` (see `Node::ownerDocument()`); nodes created on their own
+     * have no document and use the defaults.
+     */
+    class Document
+    {
+    public:
+        /* Text nodes longer than this are never interned: */
+        static constexpr size_t MAX_INTERNED_TEXT = 64;
+
+        void internStrings(bool enable = true); /** Turn the string pool on or off */
+        bool internsStrings() const; /** Return true if the string pool is on */
+        StringPool& stringPool(); /** Get the string pool of the document */
+        ClassTable& classTable(); /** Get the tokens of the class names used in the document */
+        const ClassTable& classTable() const;
+
+        void addId(const std::string& id, Node* element); /** Index `element` under its `id` attribute */
+        void removeId(const std::string& id, Node* element);
+        const std::vector<Node*>& elementsById(const std::string& id) const; /** Get the elements with `id`, any order */
+
+        ChildIndex* childIndex(const Node* parent) const; /** Get the index of the children of `parent`, null if none */
+        /** Set the index of the children of `parent`; null drops it. Its bytes are counted, see `memory()` */
+        void childIndex(const Node* parent, std::unique_ptr<ChildIndex> index);
+        std::unique_ptr<ChildIndex> releaseChildIndex(const Node* parent); /** Remove and return the index of `parent` */
+
+        StringPool::Handle intern(const std::string& s); /** Get pooled `s` if the pool is on, else a new copy */
+        StringPool::Handle internText(const std::string& text); /** Same as `intern()` for short text runs */
+        AttributeValue intern(const AttributeValue& value); /** Pool the string of `value`, if any */
+
+        /** Start recording mutations into a journal of `capacity` records (restarts a running one) */
+        Journal& startJournal(size_t capacity = Journal::DEFAULT_CAPACITY);
+        void stopJournal(); /** Stop recording and drop the journal */
+        Journal* journal() const; /** Get the journal, null if not recording */
+
+        /**
+         * Get the generation of the document: a counter bumped by every
+         * mutation of its nodes (insertion, removal, deletion, attribute and
+         * text changes). Equal generations mean an unchanged document.
+         */
+        uint64_t generation() const;
+        void touch(); /** Bump the generation */
+        QueryCache& queryCache(); /** Get the cache of selector query results */
+        MemoryAccount& memory(); /** Get the bytes held by the nodes and the memory budget */
+        const MemoryAccount& memory() const;
+
+    private:
+        MemoryAccount memory_; // first, as the members below report to it until destroyed
+        bool intern_strings_ = false;
+        StringPool pool_;
+        ClassTable class_table_;
+        std::unordered_map<std::string, std::vector<Node*>> ids_; // usually one element per id
+        std::unordered_map<const Node*, std::unique_ptr<ChildIndex>> child_indexes_; // see `Node::indexChildren()`
+        std::unique_ptr<Journal> journal_;
+        std::atomic<uint64_t> generation_{0};
+        QueryCache query_cache_{QueryCache::DEFAULT_CAPACITY, &memory_};
+    };
+}
+
+#endif // _DOCUMENT_H
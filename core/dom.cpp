@@ -1,19 +1,25 @@
 #include "dom.h"
 #include "text_node.h"
+#include "writer.h"
 
 namespace SeeQuery
 {
-    Dom::Dom() :
-        HtmlNode("html"),
-        doctype("<!DOCTYPE html>")
+    Dom::Dom(std::shared_ptr<Document> document) :
+        HtmlNode("html", {}, document),
+        doctype_("<!DOCTYPE html>")
     {
-        append(new HtmlNode("head"));
-        append(new HtmlNode("body"));
+        append(new HtmlNode("head", {}, document));
+        append(new HtmlNode("body", {}, document));
     }
 
-    std::string Dom::serialize(size_t depth /*= 0*/) const
+    void Dom::serialize(Writer& out, size_t depth /*= 0*/) const
     {
-        return doctype + "\n"
-            + HtmlNode::serialize(depth);
+        out.writeRef(doctype_);
+        out.writeRef("\n", 1);
+        HtmlNode::serialize(out, depth);
+    }
+    const std::string& Dom::doctype() const
+    {
+        return doctype_;
     }
 }
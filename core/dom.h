@@ -9,10 +9,12 @@ namespace SeeQuery
     class Dom: public HtmlNode
     {
     public:
-        Dom();
-        std::string serialize(size_t depth = 0) const;
+        Dom(std::shared_ptr<Document> document = nullptr);
+        using HtmlNode::serialize;
+        void serialize(Writer& out, size_t depth = 0) const;
+        const std::string& doctype() const; /** Get the doctype declaration written before the markup */
     private:
-        std::string doctype;
+        std::string doctype_;
     };
 }
 
@@ -0,0 +1,125 @@
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <unistd.h>
+#include "fd_writer.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        constexpr size_t MAX_IOV = 1024; // the POSIX minimum of IOV_MAX
+    }
+
+    constexpr size_t FdWriter::MIN_REF_SIZE;
+
+    FdWriter::FdWriter(int fd, size_t buffer_size) :
+        fd_(fd),
+        buffer_(buffer_size)
+    {
+        iov_.reserve(MAX_IOV);
+    }
+    FdWriter::~FdWriter()
+    {
+        try {
+            flush();
+        } catch (const std::system_error&) {
+            // Destructors must not throw.
+        }
+    }
+    void FdWriter::write(const char* data, size_t size)
+    {
+        if (used_ + size > buffer_.size()) {
+            flush();
+            if (size > buffer_.size()) {
+                writeAll(data, size);
+                return;
+            }
+        }
+        std::memcpy(buffer_.data() + used_, data, size);
+        push(buffer_.data() + used_, size);
+        used_ += size;
+    }
+    void FdWriter::writeRef(const char* data, size_t size)
+    {
+        if (size < MIN_REF_SIZE) {
+            write(data, size);
+            return;
+        }
+        push(data, size);
+    }
+    void FdWriter::push(const char* data, size_t size)
+    {
+        if (size == 0) {
+            return;
+        }
+        // Consecutive pieces of the buffer share one iovec:
+        if (!iov_.empty()) {
+            iovec& last = iov_.back();
+            if (static_cast<char*>(last.iov_base) + last.iov_len == data) {
+                last.iov_len += size;
+                return;
+            }
+        }
+        if (iov_.size() == MAX_IOV) {
+            // Data may point into the buffer that `flush()` recycles:
+            size_t offset = static_cast<size_t>(data - buffer_.data());
+            bool in_buffer = data >= buffer_.data() && offset < buffer_.size();
+            flush();
+            if (in_buffer) {
+                std::memmove(buffer_.data(), data, size);
+                data = buffer_.data();
+                used_ = 0;
+            }
+        }
+        iov_.push_back(iovec{const_cast<char*>(data), size});
+    }
+    void FdWriter::flush()
+    {
+        size_t first = 0;
+        while (first < iov_.size()) {
+            ssize_t n = ::writev(fd_, iov_.data() + first, static_cast<int>(iov_.size() - first));
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                int error = errno;
+                iov_.clear();
+                used_ = 0;
+                throw std::system_error(error, std::generic_category(), "writev");
+            }
+            bytes_written_ += static_cast<size_t>(n);
+            // Skip what has been written, possibly stopping in the middle of an iovec:
+            size_t left = static_cast<size_t>(n);
+            while (first < iov_.size() && left >= iov_[first].iov_len) {
+                left -= iov_[first].iov_len;
+                ++first;
+            }
+            if (left > 0) {
+                iov_[first].iov_base = static_cast<char*>(iov_[first].iov_base) + left;
+                iov_[first].iov_len -= left;
+            }
+        }
+        iov_.clear();
+        used_ = 0;
+    }
+    void FdWriter::writeAll(const char* data, size_t size)
+    {
+        while (size > 0) {
+            ssize_t n = ::write(fd_, data, size);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "write");
+            }
+            bytes_written_ += static_cast<size_t>(n);
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+    size_t FdWriter::bytesWritten() const
+    {
+        return bytes_written_;
+    }
+}
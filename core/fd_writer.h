@@ -0,0 +1,52 @@
+#ifndef _FD_WRITER_H
+#define _FD_WRITER_H
+
+#include <vector>
+#include <sys/uio.h>
+#include "writer.h"
+
+namespace SeeQuery
+{
+    /**
+     * Writer sending the output straight to a POSIX file descriptor.
+     *
+     * Referenced pieces (text, attribute values, ...) are not copied: the
+     * writer collects an iovec array pointing to them and hands it to a
+     * single `writev()` call. Only pieces that must be copied, and pieces
+     * too short to be worth their own iovec, go through a fixed-size buffer,
+     * so memory use is bounded regardless of the document size.
+     *
+     * Write errors are reported as `std::system_error`.
+     */
+    class FdWriter: public Writer
+    {
+    public:
+        using Writer::write;
+        using Writer::writeRef;
+
+        /* Referenced pieces shorter than this are copied into the buffer: */
+        static constexpr size_t MIN_REF_SIZE = 64;
+
+        explicit FdWriter(int fd, size_t buffer_size = 64 * 1024);
+        ~FdWriter(); /** Flush, ignoring errors; call `flush()` to see them */
+        FdWriter(const FdWriter&) = delete;
+        FdWriter& operator=(const FdWriter&) = delete;
+
+        void write(const char* data, size_t size);
+        void writeRef(const char* data, size_t size);
+        void flush();
+
+        size_t bytesWritten() const; /** Get the number of bytes passed to the descriptor */
+    private:
+        void push(const char* data, size_t size);
+        void writeAll(const char* data, size_t size);
+
+        int fd_;
+        std::vector<char> buffer_;
+        size_t used_ = 0;
+        std::vector<iovec> iov_;
+        size_t bytes_written_ = 0;
+    };
+}
+
+#endif // _FD_WRITER_H
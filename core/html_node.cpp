@@ -1,22 +1,77 @@
 #include <list>
+#include <memory>
 #include <algorithm>
 #include "html_node.h"
 #include "text_node.h"
+#include "document.h"
+#include "journal.h"
+#include "writer.h"
+#include "trace.h"
 
 namespace SeeQuery
 {
+    namespace
+    {
+        // Traversals recurse through children; only the outermost call is traced.
+        thread_local size_t traversal_depth = 0;
+
+        struct Traversal
+        {
+            Traversal() { ++traversal_depth; }
+            ~Traversal() { --traversal_depth; }
+            bool outermost() const { return traversal_depth == 1; }
+        };
+
+        /* Bits of the node summaries, see `Node::summary()`: */
+        uint64_t summary_bit(uint64_t hash)
+        {
+            // Fibonacci hashing: the top 6 bits of the product pick the bit.
+            return uint64_t(1) << ((hash * 0x9E3779B97F4A7C15ull) >> 58);
+        }
+        uint64_t tag_bit(const std::string& tag_name)
+        {
+            return summary_bit(std::hash<std::string>()(tag_name) * 3 + 0);
+        }
+        uint64_t class_bit(const std::string& class_name)
+        {
+            // By name, as tokens differ between documents:
+            return summary_bit(std::hash<std::string>()(class_name) * 3 + 2);
+        }
+
+        /* Bytes of an attribute, see `MemoryAccount`: the hash table node
+           (entry, link and cached hash) and the key and value strings. */
+        const size_t ATTRIBUTE_OVERHEAD =
+            sizeof(std::pair<const std::string, AttributeValue>) + 2 * sizeof(void*);
+
+        size_t attribute_bytes(const std::string& key, size_t value_length)
+        {
+            return ATTRIBUTE_OVERHEAD + key.size() + value_length;
+        }
+        size_t attribute_bytes(const std::string& key, const AttributeValue& value)
+        {
+            return attribute_bytes(key, value.isNumber() ? 0 : value.string()->size());
+        }
+    }
+
     HtmlNode::HtmlNode(const std::string& tag_name, 
-            std::initializer_list<Attribute> attributes) :
+            std::initializer_list<Attribute> attributes,
+            std::shared_ptr<Document> document) :
         tag_name_(tag_name)
     {
+        document_ = std::move(document);
         for (auto& attr: attributes)
         {
             if (attr.key.compare("text") == 0) {
-                append(new TextNode(attr.value));
+                append(new TextNode(attr.value.str(), document_));
+            } else if (document_) {
+                attributes_.insert(std::make_pair(attr.key, document_->intern(attr.value)));
             } else {
                 attributes_.insert(std::make_pair(attr.key, attr.value));
             }
         }
+        charge(); // on failure the text children are deleted and release their bytes
+        indexId(document_.get(), true);
+        attributeChanged("class"); // parses the classes and summarizes the node
     }
     HtmlNode::HtmlNode(const HtmlNode& other) :
         tag_name_(other.tag_name_)
@@ -24,12 +79,18 @@ namespace SeeQuery
         if (&other == this) {
             return;
         }
+        summarize(ownSummary());
         Node* child = other.firstChild();
         while (child) {
             append(child->clone());
             child = child->nextSibling();
         }
     }
+    HtmlNode::~HtmlNode()
+    {
+        indexId(document_.get(), false);
+        release();
+    }
     HtmlNode& HtmlNode::operator=(const HtmlNode& other)
     {
         if (&other == this) {
@@ -45,53 +106,115 @@ namespace SeeQuery
     Node* HtmlNode::append(Node* child)
     {
         // Detach the child if it is already embedded somewhere:
+        admit(child);
         child->detach();
-        child->parent(this);
+        adopt(child);
         if (firstChild() == nullptr) {
+            child->parent(this);
             firstChild(child);
+            linked(child);
+            if (Journal* log = journal()) {
+                log->inserted(child);
+            }
         } else {
+            // Sets the parent too:
             Node* node = lastChild();
             node->nextSibling(child);
         }
+        summarize(child->summary());
         return this;
     }
     Node* HtmlNode::prepend(Node* child)
     {
         // Detach the child if it is already embedded somewhere:
+        admit(child);
         child->detach();
-        child->parent(this);
+        adopt(child);
         Node* first_child = firstChild();
         if (first_child == nullptr) {
+            child->parent(this);
             firstChild(child);
+            linked(child);
+            if (Journal* log = journal()) {
+                log->inserted(child);
+            }
         } else {
+            // Sets the parent too:
             first_child->prevSibling(child);
         }
+        summarize(child->summary());
         return this;
     }
+    void HtmlNode::appendText(const std::string& text)
+    {
+        Node* last = firstChild() ? lastChild() : nullptr;
+        if (last && last->nodeType() == TEXT_NODE) {
+            static_cast<TextNode*>(last)->appendText(text);
+        } else {
+            append(new TextNode(text, document_));
+        }
+    }
+    void HtmlNode::normalize()
+    {
+        Node* node = firstChild();
+        TextNode* previous = nullptr; // text node the following text is merged into
+        while (node) {
+            Node* next = node->nextSibling();
+            if (node->nodeType() != TEXT_NODE) {
+                static_cast<HtmlNode*>(node)->normalize();
+                previous = nullptr;
+            } else if (previous || static_cast<TextNode*>(node)->length() == 0) {
+                if (previous) {
+                    previous->appendText(*static_cast<TextNode*>(node));
+                }
+                delete node->detach();
+            } else {
+                previous = static_cast<TextNode*>(node);
+            }
+            node = next;
+        }
+    }
     void HtmlNode::attr(Attribute attr)
     {
-        attributes_.insert(std::make_pair(attr.key, attr.value));
+        if (attributes_.count(attr.key)) {
+            return;
+        }
+        charge(MemoryAccount::ATTRIBUTES, 0, attribute_bytes(attr.key, attr.value));
+        auto inserted = attributes_.insert(std::make_pair(attr.key, pooled(attr.value)));
+        if (inserted.second) {
+            attributeChanged(attr.key);
+            if (Journal* log = journal()) {
+                log->attributeSet(this, attr.key, inserted.first->second);
+            }
+        }
     }
-    std::string HtmlNode::serialize(size_t depth /*default: 0*/) const
+    void HtmlNode::serialize(Writer& out, size_t depth /*default: 0*/) const
     {
-        std::string indent(depth * INDENT_WIDTH, ' ');
-        std::ostringstream oss;
-        oss << indent << "<" << tag_name_;
+        out.indent(depth);
+        out.writeRef("<", 1);
+        out.writeRef(tag_name_);
         for (auto& attr: attributes_) {
-            oss << " " << attr.first << "=\"" << attr.second << "\"";
+            out.writeRef(" ", 1);
+            out.writeRef(attr.first);
+            out.writeRef("=\"", 2);
+            attr.second.write(out);
+            out.writeRef("\"", 1);
         }
         if (firstChild() == nullptr) {
-            oss << "/>";
+            out.writeRef("/>", 2);
         } else {
-            oss << ">" << std::endl;
+            out.writeRef(">\n", 2);
             Node* node = firstChild();
             while (node) {
-                oss << node->serialize(depth + 1) << std::endl;
+                node->serialize(out, depth + 1);
+                out.writeRef("\n", 1);
                 node = node->nextSibling();
             }
-            oss << indent << "</" << tag_name_ << ">";
+            out.indent(depth);
+            out.writeRef("</", 2);
+            out.writeRef(tag_name_);
+            out.writeRef(">", 1);
         }
-        return oss.str();
     }
     std::string HtmlNode::tagName() const
     {
@@ -99,51 +222,220 @@ namespace SeeQuery
     }
     std::string HtmlNode::text() const
     {
-        std::ostringstream oss;
-        Node* node = firstChild();
-        while (node) {
-            oss << node->serialize() << std::endl;
-            node = node->nextSibling();
+        // As the DOM `textContent`: the text of all descendants, concatenated.
+        size_t length = 0;
+        for (Node& node: descendants()) {
+            if (node.nodeType() == TEXT_NODE) {
+                length += static_cast<TextNode&>(node).length();
+            }
+        }
+        std::string result;
+        result.reserve(length);
+        for (Node& node: descendants()) {
+            if (node.nodeType() == TEXT_NODE) {
+                static_cast<TextNode&>(node).appendTo(result);
+            }
         }
-        return oss.str();
+        return result;
     }
     std::string HtmlNode::html() const
     {
-        return serialize();
+        return serialize(); // sized exactly before it is built
     }
     std::string HtmlNode::attr(const std::string& key) const
     {
         auto it = attributes_.find(key);
         if (it != attributes_.cend()) {
-            return it->second;
+            return it->second.str();
         }
         return "";
     }
     void HtmlNode::attr(const std::string& key, const std::string& value)
     {
-        attributes_[key] = value;
+        auto it = attributes_.find(key);
+        charge(MemoryAccount::ATTRIBUTES,
+            it != attributes_.end() ? attribute_bytes(key, it->second) : 0,
+            attribute_bytes(key, value.size()));
+        attributeChanging(key);
+        // Pooled values are shared, so the new value replaces (never modifies) the old one:
+        AttributeValue& stored = it != attributes_.end() ? it->second : attributes_[key];
+        stored = pooled(AttributeValue(value));
+        attributeChanged(key);
+        if (Journal* log = journal()) {
+            log->attributeSet(this, key, stored);
+        }
+    }
+    AttributeValue HtmlNode::attrValue(const std::string& key) const
+    {
+        auto it = attributes_.find(key);
+        if (it != attributes_.cend()) {
+            return it->second;
+        }
+        return AttributeValue();
+    }
+    void HtmlNode::attr(const std::string& key, const AttributeValue& value)
+    {
+        auto it = attributes_.find(key);
+        charge(MemoryAccount::ATTRIBUTES,
+            it != attributes_.end() ? attribute_bytes(key, it->second) : 0,
+            attribute_bytes(key, value));
+        attributeChanging(key);
+        AttributeValue& stored = it != attributes_.end() ? it->second : attributes_[key];
+        stored = pooled(value);
+        attributeChanged(key);
+        if (Journal* log = journal()) {
+            log->attributeSet(this, key, stored);
+        }
+    }
+    void HtmlNode::removeAttr(const std::string& key)
+    {
+        auto it = attributes_.find(key);
+        if (it != attributes_.end()) {
+            charge(MemoryAccount::ATTRIBUTES, attribute_bytes(key, it->second), 0);
+            attributeChanging(key);
+            attributes_.erase(it);
+            attributeChanged(key);
+            if (Journal* log = journal()) {
+                log->attributeRemoved(this, key);
+            }
+        }
+    }
+    AttributeValue HtmlNode::pooled(const AttributeValue& value) const
+    {
+        return document_ ? document_->intern(value) : value;
+    }
+    void HtmlNode::attributeChanging(const std::string& key)
+    {
+        if (key == "id") {
+            indexId(document_.get(), false);
+        }
+    }
+    void HtmlNode::attributeChanged(const std::string& key)
+    {
+        changed();
+        if (key == "class") {
+            parseClasses();
+            summarize(ownSummary());
+        } else if (key == "id") {
+            indexId(document_.get(), true);
+        }
+    }
+    void HtmlNode::adopted(Document* previous)
+    {
+        indexId(previous, false);
+        indexId(document_.get(), true);
+        parseClasses(); // the tokens are those of the previous document
+    }
+    void HtmlNode::indexId(Document* document, bool add)
+    {
+        if (!document) {
+            return;
+        }
+        auto it = attributes_.find("id");
+        if (it == attributes_.end()) {
+            return;
+        }
+        if (add) {
+            document->addId(it->second.str(), this);
+        } else {
+            document->removeId(it->second.str(), this);
+        }
+    }
+    void HtmlNode::parseClasses()
+    {
+        size_t tokens = classes_.size();
+        auto it = attributes_.find("class");
+        if (it != attributes_.end() && document_) {
+            ClassTable& table = document_->classTable();
+            size_t table_bytes = table.bytes();
+            classes_.assign(it->second.str(), table);
+            document_->memory().adjust(MemoryAccount::DOCUMENT, table_bytes, table.bytes());
+        } else {
+            classes_.clear();
+        }
+        account(MemoryAccount::ATTRIBUTES, tokens * sizeof(ClassList::Token),
+            classes_.size() * sizeof(ClassList::Token));
+    }
+    uint64_t HtmlNode::ownSummary() const
+    {
+        uint64_t bits = tag_bit(tag_name_);
+        auto it = attributes_.find("class");
+        if (it != attributes_.end()) {
+            for (auto& class_name: ClassList::split(it->second.str())) {
+                bits |= class_bit(class_name);
+            }
+        }
+        return bits;
+    }
+    const std::unordered_map<std::string, AttributeValue>& HtmlNode::attributes() const
+    {
+        return attributes_;
+    }
+    bool HtmlNode::hasClass(const std::string& class_name) const
+    {
+        if (document_) {
+            ClassList::Token token = document_->classTable().find(class_name);
+            return token != ClassList::NONE && classes_.contains(token);
+        }
+        auto it = attributes_.find("class");
+        if (it == attributes_.end()) {
+            return false;
+        }
+        std::string value = it->second.str();
+        return ClassList::contains(value.data(), value.size(), class_name);
+    }
+    const ClassList& HtmlNode::classList() const
+    {
+        return classes_;
     }
     Node* HtmlNode::getElementById(const std::string& id)
     {
+        Traversal traversal;
+        TraceScope trace("HtmlNode::getElementById", id, traversal.outermost());
+        if (document_) {
+            // The first of the elements with `id` in this subtree:
+            Node* result = nullptr;
+            for (Node* element: document_->elementsById(id)) {
+                Node* ancestor = element;
+                while (ancestor && ancestor != this) {
+                    ancestor = ancestor->parent();
+                }
+                if (ancestor && (!result || element->precedes(*result))) {
+                    result = element;
+                }
+            }
+            trace.size(result ? 1 : 0);
+            return result;
+        }
         auto it = attributes_.find("id");
-        if (it != attributes_.end() && id.compare(it->second) == 0) {
+        if (it != attributes_.end() && it->second == id) {
+            trace.size(1);
             return this;
         }
         Node* node = firstChild();
         while (node) {
             if (Node* result = node->getElementById(id)) {
+                trace.size(1);
                 return result;
             }
             node = node->nextSibling();
         }
+        trace.size(0);
         return nullptr;
     }
     std::list<Node*> HtmlNode::getElementsByTagName(const std::string& tag_name)
     {
+        Traversal traversal;
+        TraceScope trace("HtmlNode::getElementsByTagName", tag_name, traversal.outermost());
         std::list<Node*> result;
+        if (!(summary() & tag_bit(tag_name))) {
+            trace.size(0);
+            return result;
+        }
         // Check if this node tag name matches:
         if (tag_name_ == tag_name) {
             result.emplace_back(this);
+            trace.size(result.size());
             return result;
         }
         // Otherwise search in children:
@@ -154,36 +446,79 @@ namespace SeeQuery
                 node->getElementsByTagName(tag_name));
             node = node->nextSibling();
         }
+        trace.size(result.size());
         return result;
     }
     std::list<Node*> HtmlNode::getElementsByClassName(const std::string& class_name)
     {
+        TraceScope trace("HtmlNode::getElementsByClassName", class_name);
         std::list<Node*> result;
-        // Check if this node class matches:
-        auto it = attributes_.find("class");
-        if (it != attributes_.end() && class_name.compare(it->second) == 0) {
-            result.push_back(this);
-            return result;
+        // Look the class up once, then compare tokens only (the subtree
+        // shares the document, and so the class table):
+        ClassList::Token token = ClassList::NONE;
+        if (document_) {
+            token = document_->classTable().find(class_name);
+            if (token == ClassList::NONE) {
+                trace.size(0);
+                return result;
+            }
         }
-        // Otherwise, search in children:
-        Node* node = firstChild();
+        // Walk the subtree in document order, not descending into matches
+        // nor into subtrees whose summary rules the class out:
+        uint64_t bit = class_bit(class_name);
+        Node* node = this;
         while (node) {
-            result.splice(
-                result.end(),
-                node->getElementsByClassName(class_name));
-            node = node->nextSibling();
+            bool candidate = (node->summary() & bit) != 0;
+            bool match = candidate && node->nodeType() == ELEMENT_NODE
+                && (document_
+                    ? static_cast<HtmlNode*>(node)->classes_.contains(token)
+                    : static_cast<HtmlNode*>(node)->hasClass(class_name));
+            if (match) {
+                result.push_back(node);
+            }
+            Node* next = candidate && !match ? node->firstChild() : nullptr;
+            while (!next && node != this) {
+                next = node->nextSibling();
+                if (!next) {
+                    node = node->parent();
+                }
+            }
+            node = next;
         }
+        trace.size(result.size());
         return result;
     }
+    int HtmlNode::nodeType() const
+    {
+        return ELEMENT_NODE;
+    }
     Node* HtmlNode::clone() const
     {
-        HtmlNode* copy = new HtmlNode(tag_name_);
-        copy->attributes_ = attributes_;
+        // Owned until complete, so a clone failing on the memory budget is freed:
+        std::unique_ptr<HtmlNode> copy(new HtmlNode(tag_name_, {}, document_));
+        size_t attributes_bytes = 0;
+        for (auto& attr: attributes_) {
+            attributes_bytes += attribute_bytes(attr.first, attr.second);
+        }
+        attributes_bytes += classes_.size() * sizeof(ClassList::Token);
+        copy->charge(MemoryAccount::ATTRIBUTES, 0, attributes_bytes);
+        copy->attributes_ = attributes_; // values are shared, not copied
+        copy->indexId(document_.get(), true);
+        copy->classes_ = classes_;
+        copy->summarize(copy->ownSummary());
         Node* node = firstChild();
         while (node) {
             copy->append(node->clone());
             node = node->nextSibling();
         }
-        return copy;
+        return copy.release();
+    }
+    void HtmlNode::memoryUsage(MemoryAccount::Usage& usage) const
+    {
+        usage[MemoryAccount::NODES] += sizeof(HtmlNode) + tag_name_.size();
+        for (auto& attr: attributes_) {
+            usage[MemoryAccount::ATTRIBUTES] += attribute_bytes(attr.first, attr.second);
+        }
+        usage[MemoryAccount::ATTRIBUTES] += classes_.size() * sizeof(ClassList::Token);
     }
 }
\ No newline at end of file
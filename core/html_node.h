@@ -6,6 +6,8 @@
 #include <memory>
 #include <sstream>
 #include "node.h"
+#include "attribute_value.h"
+#include "class_list.h"
 
 namespace SeeQuery
 {
@@ -22,43 +24,73 @@ namespace SeeQuery
         template <class T>
         Attribute(const std::string& k, T v) :
             key(k),
-            value(std::to_string(v))
+            value(v)
         {}
         operator std::pair<std::string,std::string>()
         {
-            return std::make_pair(key, value);
+            return std::make_pair(key, value.str());
         }
         std::string key;
-        std::string value;
+        AttributeValue value; // numbers are stored as is and formatted on output
     };
 
     class HtmlNode: public Node
     {
     public:
-        HtmlNode(const std::string& tag_name, std::initializer_list<Attribute> attributes = {});
+        HtmlNode(const std::string& tag_name, std::initializer_list<Attribute> attributes = {},
+            std::shared_ptr<Document> document = nullptr);
         HtmlNode(const HtmlNode& other);
         HtmlNode& operator=(const HtmlNode& other);
+        ~HtmlNode();
 
         Node* getElementById(const std::string& id);
         std::list<Node*> getElementsByTagName(const std::string& tag_name);
         std::list<Node*> getElementsByClassName(const std::string& class_name);
 
+        int nodeType() const;
         Node* clone() const;
+        void memoryUsage(MemoryAccount::Usage& usage) const;
 
-        std::string serialize(size_t depth = 0) const;
+        using Node::serialize;
+        void serialize(Writer& out, size_t depth = 0) const;
         std::string tagName() const;
         std::string text() const;
         std::string html() const;
 
         std::string attr(const std::string& key) const;
         void attr(const std::string& key, const std::string& value);
+        AttributeValue attrValue(const std::string& key) const;
+        void attr(const std::string& key, const AttributeValue& value);
+        void removeAttr(const std::string& key); /** Remove attribute `key`, if set */
+        const std::unordered_map<std::string, AttributeValue>& attributes() const;
+        bool hasClass(const std::string& class_name) const; /** Return true if `class_name` is one of the classes */
+        /** Get the parsed tokens of the `class` attribute; empty for nodes without a document */
+        const ClassList& classList() const;
 
         Node* append(Node* child);
         Node* prepend(Node* child);
         void attr(Attribute attr);
+
+        /** Append `text` to the last child if it is a text node, else add a text node */
+        void appendText(const std::string& text);
+        /**
+         * Merge adjacent text nodes and drop empty ones in this subtree, as
+         * the DOM `normalize()`. Merged nodes share their chunks; the nodes
+         * merged away are deleted.
+         */
+        void normalize();
     protected:
+        AttributeValue pooled(const AttributeValue& value) const; /** Intern `value` in the document pool */
+        void attributeChanging(const std::string& key); /** Update derived state before `key` is set */
+        void attributeChanged(const std::string& key); /** Update derived state after `key` was set */
+        void adopted(Document* previous);
+        void indexId(Document* document, bool add); /** Add this node to or remove it from the ids of `document` */
+        void parseClasses(); /** Tokenize the `class` attribute with the class table of the document */
+        uint64_t ownSummary() const; /** Get the summary bits of the tag and classes of this node */
+
         std::string tag_name_;
-        std::unordered_map<std::string, std::string> attributes_;
+        std::unordered_map<std::string, AttributeValue> attributes_;
+        ClassList classes_; // tokens of the `class` attribute; nodes without a document match the value
     };
 }
 
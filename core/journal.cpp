@@ -0,0 +1,110 @@
+#include <algorithm>
+#include "journal.h"
+#include "node.h"
+
+namespace SeeQuery
+{
+    constexpr size_t Journal::DEFAULT_CAPACITY;
+
+    Journal::Journal(size_t capacity, MemoryAccount* memory) :
+        memory_(memory)
+    {
+        capacity = std::max<size_t>(capacity, 1);
+        if (memory_) {
+            memory_->charge(MemoryAccount::DOCUMENT, capacity * sizeof(Mutation));
+        }
+        ring_.resize(capacity);
+    }
+    Journal::~Journal()
+    {
+        if (memory_) {
+            memory_->release(MemoryAccount::DOCUMENT, ring_.size() * sizeof(Mutation) + bytes_);
+        }
+    }
+    size_t Journal::capacity() const
+    {
+        return ring_.size();
+    }
+    size_t Journal::size() const
+    {
+        return size_;
+    }
+    size_t Journal::dropped() const
+    {
+        return dropped_;
+    }
+    size_t Journal::drain(std::vector<Mutation>& batch, size_t max)
+    {
+        size_t n = std::min(max, size_);
+        for (size_t i = 0; i < n; ++i) {
+            // Copied, not moved: the slots keep their string capacity for reuse.
+            batch.push_back(ring_[head_]);
+            head_ = (head_ + 1) % ring_.size();
+        }
+        size_ -= n;
+        return n;
+    }
+    void Journal::clear()
+    {
+        head_ = 0;
+        size_ = 0;
+        dropped_ = 0;
+    }
+    void Journal::inserted(Node* node)
+    {
+        Mutation& record = push(Mutation::INSERT, node);
+        record.parent = node->parent();
+        record.sibling = node->nextSibling();
+    }
+    void Journal::removed(Node* node, Node* parent, Node* sibling)
+    {
+        Mutation& record = push(Mutation::REMOVE, node);
+        record.parent = parent;
+        record.sibling = sibling;
+    }
+    void Journal::attributeSet(Node* node, const std::string& key, const AttributeValue& value)
+    {
+        push(Mutation::SET_ATTRIBUTE, node, key, value);
+    }
+    void Journal::attributeRemoved(Node* node, const std::string& key)
+    {
+        push(Mutation::REMOVE_ATTRIBUTE, node, key);
+    }
+    void Journal::textSet(Node* node, const AttributeValue& text)
+    {
+        push(Mutation::SET_TEXT, node, std::string(), text);
+    }
+    void Journal::textAppended(Node* node, const AttributeValue& text)
+    {
+        push(Mutation::APPEND_TEXT, node, std::string(), text);
+    }
+    Mutation& Journal::push(Mutation::Type type, Node* node, const std::string& key, const AttributeValue& value)
+    {
+        if (size_ == ring_.size()) {
+            // Full: overwrite the oldest record.
+            head_ = (head_ + 1) % ring_.size();
+            --size_;
+            ++dropped_;
+        }
+        Mutation& record = ring_[(head_ + size_) % ring_.size()];
+        ++size_;
+        size_t old_bytes = bytes(record);
+        record.type = type;
+        record.node = node;
+        record.parent = nullptr;
+        record.sibling = nullptr;
+        record.key = key;
+        record.value = value;
+        if (memory_) {
+            size_t new_bytes = bytes(record);
+            memory_->adjust(MemoryAccount::DOCUMENT, old_bytes, new_bytes);
+            bytes_ += new_bytes - old_bytes;
+        }
+        return record;
+    }
+    size_t Journal::bytes(const Mutation& record)
+    {
+        const std::string* value = record.value.string();
+        return record.key.size() + (value ? value->size() : 0);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef _JOURNAL_H
+#define _JOURNAL_H
+
+#include <string>
+#include <vector>
+#include "attribute_value.h"
+#include "memory_account.h"
+
+namespace SeeQuery
+{
+    class Node;
+
+    /**
+     * One change to a document, in the spirit of a DOM `MutationRecord`.
+     * Node pointers identify the nodes; they are only safe to dereference
+     * while the nodes are alive, so drain the journal before deleting them.
+     */
+    struct Mutation
+    {
+        enum Type {
+            INSERT, // `node` was inserted into `parent` before `sibling`
+            REMOVE, // `node` was removed from `parent`, where it stood before `sibling`
+            SET_ATTRIBUTE, // attribute `key` of `node` was set to `value`
+            REMOVE_ATTRIBUTE, // attribute `key` of `node` was removed
+            SET_TEXT, // the text of `node` was set to `value`
+            APPEND_TEXT // `value` was appended to the text of `node`
+        };
+
+        Type type;
+        Node* node;
+        Node* parent; // null for top-level siblings
+        Node* sibling; // next sibling, null at the end
+        std::string key;
+        AttributeValue value;
+    };
+
+    /**
+     * Mutation log of a document (see `Document::startJournal()`).
+     *
+     * Records go into a ring buffer allocated up front; when it is full the
+     * oldest record is overwritten and counted in `dropped()`, so a consumer
+     * that falls behind knows it has to resynchronize from scratch. When no
+     * journal is started, mutations only pay for a null check.
+     *
+     * With an account, the ring is charged when the journal is created
+     * (which throws `MemoryBudgetExceeded` if it does not fit) and the keys
+     * and string values of the records as they come and go, in
+     * `MemoryAccount::DOCUMENT`.
+     */
+    class Journal
+    {
+    public:
+        static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+        explicit Journal(size_t capacity = DEFAULT_CAPACITY, MemoryAccount* memory = nullptr);
+        ~Journal();
+        Journal(const Journal&) = delete;
+        Journal& operator=(const Journal&) = delete;
+
+        size_t capacity() const;
+        size_t size() const; /** Get the number of records waiting to be drained */
+        size_t dropped() const; /** Get the number of records overwritten before being drained */
+
+        /**
+         * Move up to `max` of the oldest records to the end of `batch` and
+         * return their number. Reusing `batch` between calls avoids
+         * allocations.
+         */
+        size_t drain(std::vector<Mutation>& batch, size_t max = static_cast<size_t>(-1));
+        void clear(); /** Drop all records and reset `dropped()` */
+
+        void inserted(Node* node); /** Record the insertion of `node` at its current place */
+        void removed(Node* node, Node* parent, Node* sibling);
+        void attributeSet(Node* node, const std::string& key, const AttributeValue& value);
+        void attributeRemoved(Node* node, const std::string& key);
+        void textSet(Node* node, const AttributeValue& text);
+        void textAppended(Node* node, const AttributeValue& text);
+
+    private:
+        /** Fill the slot of a new record */
+        Mutation& push(Mutation::Type type, Node* node, const std::string& key = std::string(),
+            const AttributeValue& value = AttributeValue());
+        static size_t bytes(const Mutation& record); /** Get the bytes of the key and string value of `record` */
+
+        std::vector<Mutation> ring_;
+        MemoryAccount* memory_;
+        size_t bytes_ = 0; // of the keys and values in the ring
+        size_t head_ = 0; // oldest record
+        size_t size_ = 0;
+        size_t dropped_ = 0;
+    };
+}
+
+#endif // _JOURNAL_H
@@ -0,0 +1,132 @@
+#include <string>
+#include "memory_account.h"
+
+namespace SeeQuery
+{
+    constexpr size_t MemoryAccount::UNLIMITED;
+
+    MemoryBudgetExceeded::MemoryBudgetExceeded(size_t requested, size_t used, size_t budget) :
+        std::runtime_error("memory budget exceeded: " + std::to_string(requested)
+            + " bytes requested, " + std::to_string(used) + " of " + std::to_string(budget) + " in use"),
+        requested_(requested),
+        used_(used),
+        budget_(budget)
+    {}
+    size_t MemoryBudgetExceeded::requested() const
+    {
+        return requested_;
+    }
+    size_t MemoryBudgetExceeded::used() const
+    {
+        return used_;
+    }
+    size_t MemoryBudgetExceeded::budget() const
+    {
+        return budget_;
+    }
+
+    MemoryAccount::MemoryAccount() :
+        total_(0),
+        peak_(0),
+        budget_(UNLIMITED)
+    {
+        for (auto& used: used_) {
+            used.store(0, std::memory_order_relaxed);
+        }
+    }
+    size_t MemoryAccount::used() const
+    {
+        return total_.load(std::memory_order_relaxed);
+    }
+    size_t MemoryAccount::used(Category category) const
+    {
+        return used_[category].load(std::memory_order_relaxed);
+    }
+    size_t MemoryAccount::peak() const
+    {
+        return peak_.load(std::memory_order_relaxed);
+    }
+    void MemoryAccount::resetPeak()
+    {
+        peak_.store(used(), std::memory_order_relaxed);
+    }
+    size_t MemoryAccount::budget() const
+    {
+        return budget_.load(std::memory_order_relaxed);
+    }
+    void MemoryAccount::budget(size_t bytes)
+    {
+        budget_.store(bytes, std::memory_order_relaxed);
+    }
+    void MemoryAccount::check(size_t bytes) const
+    {
+        size_t in_use = used();
+        size_t limit = budget();
+        if (bytes > limit || in_use > limit - bytes) {
+            throw MemoryBudgetExceeded(bytes, in_use, limit);
+        }
+    }
+    void MemoryAccount::charge(Category category, size_t bytes)
+    {
+        reserve(bytes);
+        used_[category].fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void MemoryAccount::charge(const Usage& usage)
+    {
+        reserve(total(usage));
+        for (size_t i = 0; i < CATEGORIES; ++i) {
+            used_[i].fetch_add(usage[i], std::memory_order_relaxed);
+        }
+    }
+    void MemoryAccount::release(Category category, size_t bytes)
+    {
+        used_[category].fetch_sub(bytes, std::memory_order_relaxed);
+        total_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    void MemoryAccount::release(const Usage& usage)
+    {
+        for (size_t i = 0; i < CATEGORIES; ++i) {
+            used_[i].fetch_sub(usage[i], std::memory_order_relaxed);
+        }
+        total_.fetch_sub(total(usage), std::memory_order_relaxed);
+    }
+    void MemoryAccount::adjust(Category category, size_t old_bytes, size_t new_bytes)
+    {
+        if (new_bytes > old_bytes) {
+            size_t bytes = new_bytes - old_bytes;
+            used_[category].fetch_add(bytes, std::memory_order_relaxed);
+            raisePeak(total_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+        } else {
+            release(category, old_bytes - new_bytes);
+        }
+    }
+    size_t MemoryAccount::total(const Usage& usage)
+    {
+        size_t sum = 0;
+        for (size_t bytes: usage) {
+            sum += bytes;
+        }
+        return sum;
+    }
+    void MemoryAccount::reserve(size_t bytes)
+    {
+        // Add only if the result stays within the budget, so concurrent
+        // charges cannot overshoot it together:
+        size_t in_use = total_.load(std::memory_order_relaxed);
+        size_t result;
+        do {
+            size_t limit = budget();
+            if (bytes > limit || in_use > limit - bytes) {
+                throw MemoryBudgetExceeded(bytes, in_use, limit);
+            }
+            result = in_use + bytes;
+        } while (!total_.compare_exchange_weak(in_use, result, std::memory_order_relaxed));
+        raisePeak(result);
+    }
+    void MemoryAccount::raisePeak(size_t used)
+    {
+        size_t peak = peak_.load(std::memory_order_relaxed);
+        while (peak < used && !peak_.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
+        }
+    }
+}
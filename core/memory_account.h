@@ -0,0 +1,93 @@
+#ifndef _MEMORY_ACCOUNT_H
+#define _MEMORY_ACCOUNT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <stdexcept>
+
+namespace SeeQuery
+{
+    /** Thrown by mutations that would take a document over its memory budget */
+    class MemoryBudgetExceeded: public std::runtime_error
+    {
+    public:
+        MemoryBudgetExceeded(size_t requested, size_t used, size_t budget);
+        size_t requested() const; /** Get the bytes the failed mutation asked for */
+        size_t used() const; /** Get the bytes in use when it failed */
+        size_t budget() const;
+    private:
+        size_t requested_;
+        size_t used_;
+        size_t budget_;
+    };
+
+    /**
+     * Bytes held by the nodes of one document and by the structures the
+     * document keeps for them, by category, with the high-water mark and an
+     * optional budget (see `Document::memory()`).
+     *
+     * Nodes charge their own bytes (`Node::memoryUsage()`) when created or
+     * moved into the document and whenever attributes or text grow, and
+     * release them when they shrink, leave or are deleted. A charge that
+     * would exceed the budget throws `MemoryBudgetExceeded` before anything
+     * changes, so a failed mutation leaves the tree as it was.
+     *
+     * Structures derived from an admitted change (class tokens, text chunk
+     * lists, child indexes, the id and class tables, journal records) are
+     * counted with `adjust()`, which never throws: they may take the total
+     * past the budget by their size, and the next charge then fails. Query
+     * results are only cached while they fit in the budget.
+     *
+     * Strings are counted by length for every node referencing them, even
+     * when pooled or shared between clones, so for strings the figure is an
+     * upper bound: what the document would take on its own. Allocator
+     * overhead is not counted. Safe to update from several threads.
+     */
+    class MemoryAccount
+    {
+    public:
+        enum Category {
+            NODES,      // node objects and tag names
+            ATTRIBUTES, // attribute entries, keys and string values
+            TEXT,       // text of the text nodes
+            DOCUMENT,   // child indexes, id and class tables, query cache and journal
+            CATEGORIES
+        };
+        typedef std::array<size_t, CATEGORIES> Usage;
+
+        static constexpr size_t UNLIMITED = SIZE_MAX;
+
+        MemoryAccount();
+
+        size_t used() const; /** Get the bytes in use */
+        size_t used(Category category) const; /** Get the bytes in use in `category` */
+        size_t peak() const; /** Get the highest number of bytes in use so far */
+        void resetPeak(); /** Restart the high-water mark from the bytes in use */
+
+        size_t budget() const;
+        void budget(size_t bytes); /** Set the most bytes in use allowed, `UNLIMITED` by default */
+
+        void check(size_t bytes) const; /** Throw `MemoryBudgetExceeded` if `bytes` more would exceed the budget */
+        void charge(Category category, size_t bytes); /** Add `bytes` to `category`, or throw as `check()` */
+        void charge(const Usage& usage); /** Add `usage` as a whole, or throw as `check()` */
+        void release(Category category, size_t bytes);
+        void release(const Usage& usage);
+        /** Account for `category` going from `old_bytes` to `new_bytes`, without the budget check */
+        void adjust(Category category, size_t old_bytes, size_t new_bytes);
+
+        static size_t total(const Usage& usage); /** Get the sum of the categories of `usage` */
+
+    private:
+        void reserve(size_t bytes); /** Add `bytes` to the total, or throw as `check()` */
+        void raisePeak(size_t used); /** Raise the high-water mark to `used` */
+
+        std::atomic<size_t> used_[CATEGORIES];
+        std::atomic<size_t> total_;
+        std::atomic<size_t> peak_;
+        std::atomic<size_t> budget_;
+    };
+}
+
+#endif // _MEMORY_ACCOUNT_H
@@ -1,9 +1,27 @@
+#include <algorithm>
+#include <stdexcept>
 #include "node.h"
+#include "child_index.h"
+#include "document.h"
+#include "journal.h"
+#include "writer.h"
 
 namespace SeeQuery
 {
+    namespace
+    {
+        /* Order labels, see `Node::precedes()`: */
+        const uint64_t MAX_LABEL = uint64_t(1) << 63;
+        const uint64_t LABEL_STEP = uint64_t(1) << 32; // gap left after appended nodes
+        const size_t RADIX_SORT_THRESHOLD = 256; // smaller inputs are sorted by comparison
+    }
+
     Node::~Node()
     {
+        if (indexed_) {
+            document_->childIndex(this, nullptr);
+        }
+        changed();
         if (parent_ == nullptr) {
             // If this is the root-level then recursively delete
             // children and siblings:
@@ -21,6 +39,16 @@ namespace SeeQuery
             delete first_child_;
         }
     }
+    std::string Node::serialize(size_t depth) const
+    {
+        // Measure first, so the output is built in a single allocation:
+        CountingWriter counter;
+        serialize(counter, depth);
+        StringWriter out;
+        out.reserve(counter.size());
+        serialize(out, depth);
+        return std::move(out.str());
+    }
     std::list<Node*> Node::getChildren() const
     {
         std::list<Node*> result;
@@ -31,12 +59,21 @@ namespace SeeQuery
         }
         return result;
     }
+    NodeRange<ChildIterator> Node::childNodes() const
+    {
+        return NodeRange<ChildIterator>(ChildIterator(this, first_child_), ChildIterator(this));
+    }
+    NodeRange<DescendantIterator> Node::descendants() const
+    {
+        return NodeRange<DescendantIterator>(DescendantIterator(this, first_child_), DescendantIterator(this));
+    }
     Node* Node::parent() const
     {
         return parent_;
     }
     void Node::parent(Node* p)
     {
+        changed();
         parent_ = p;
     }
     Node* Node::nextSibling() const
@@ -48,7 +85,9 @@ namespace SeeQuery
         if (s == nullptr) {
             return; // do nothing
         }
+        admit(s);
         s->detach();
+        adopt(s);
         s->prev_sibling_ = this;
         s->next_sibling_ = next_sibling_;
         if (next_sibling_) {
@@ -60,8 +99,16 @@ namespace SeeQuery
             first->prev_sibling_ = s;
         }
         next_sibling_ = s;
+        changed();
         // Set new parent:
         s->parent_ = parent_;
+        if (parent_) {
+            parent_->summarize(s->summary_);
+        }
+        linked(s);
+        if (Journal* log = journal()) {
+            log->inserted(s);
+        }
     }
     Node* Node::prevSibling() const
     {
@@ -75,7 +122,9 @@ namespace SeeQuery
         if (s == nullptr) {
             return; // do nothing
         }
+        admit(s);
         s->detach();
+        adopt(s);
         s->prev_sibling_ = prev_sibling_;
         s->next_sibling_ = this;
 
@@ -88,7 +137,15 @@ namespace SeeQuery
         }
 
         prev_sibling_ = s;
+        changed();
         s->parent_ = parent_;
+        if (parent_) {
+            parent_->summarize(s->summary_);
+        }
+        linked(s);
+        if (Journal* log = journal()) {
+            log->inserted(s);
+        }
     }
     const Node* Node::firstSibling() const
     {
@@ -143,12 +200,81 @@ namespace SeeQuery
     }
     void Node::firstChild(Node* node)
     {
+        changed();
         first_child_ = node;
     }
     Node* Node::lastChild() const
     {
         return first_child_->prev_sibling_;
     }
+    void Node::indexChildren(bool enable)
+    {
+        if (!enable) {
+            if (indexed_) {
+                document_->childIndex(this, nullptr);
+                indexed_ = false;
+            }
+        } else if (!indexed_) {
+            if (!document_) {
+                throw std::logic_error("Node::indexChildren: the node has no document");
+            }
+            std::unique_ptr<ChildIndex> index(new ChildIndex(*this));
+            document_->memory().check(index->bytes());
+            document_->childIndex(this, std::move(index));
+            indexed_ = true;
+        }
+    }
+    bool Node::indexesChildren() const
+    {
+        return indexed_;
+    }
+    ChildIndex* Node::childIndex() const
+    {
+        return indexed_ ? document_->childIndex(this) : nullptr;
+    }
+    size_t Node::childCount() const
+    {
+        if (ChildIndex* child_index = childIndex()) {
+            return child_index->size();
+        }
+        size_t count = 0;
+        for (Node* child = first_child_; child; child = child->next_sibling_) {
+            ++count;
+        }
+        return count;
+    }
+    Node* Node::childAt(size_t index) const
+    {
+        if (ChildIndex* child_index = childIndex()) {
+            return child_index->at(index);
+        }
+        Node* child = first_child_;
+        for (; child && index; --index) {
+            child = child->next_sibling_;
+        }
+        return child;
+    }
+    size_t Node::index() const
+    {
+        if (ChildIndex* child_index = parent_ ? parent_->childIndex() : nullptr) {
+            return child_index->indexOf(this);
+        }
+        size_t index = 0;
+        for (const Node* node = prevSibling(); node; node = node->prevSibling()) {
+            ++index;
+        }
+        return index;
+    }
+    Node* Node::insertChild(size_t index, Node* child)
+    {
+        Node* next = childAt(index);
+        if (next && next != child) {
+            next->prevSibling(child);
+        } else if (!next) {
+            append(child);
+        }
+        return this;
+    }
     bool Node::isFirst() const
     {
         // The first node always points back to the last one:
@@ -162,11 +288,28 @@ namespace SeeQuery
     {
         Node* next = nextSibling();
         Node* prev = prevSibling();
+        if (ChildIndex* child_index = parent_ ? parent_->childIndex() : nullptr) {
+            size_t before = child_index->bytes();
+            child_index->erase(this);
+            parent_->account(MemoryAccount::DOCUMENT, before, child_index->bytes());
+        }
+        if (Journal* log = journal()) {
+            if (parent_ || next || prev) {
+                log->removed(this, parent_, next);
+            }
+        }
+        if (parent_ || next || prev) {
+            changed();
+        }
         if (prev) {
             // If this is not the 1st child, then just connect `prev` with `next`:
+            Node* first = firstSibling();
             prev->next_sibling_ = next;
             if (next) {
                 next->prev_sibling_ = prev;
+            } else {
+                // This was the last one, the 1st sibling must point to the new last:
+                first->prev_sibling_ = prev;
             }
         } else {
             // If this is the 1st child, then change parent's pointer to the 1st child:
@@ -185,9 +328,259 @@ namespace SeeQuery
         // And return the detached node:
         return this;
     }
+    const std::shared_ptr<Document>& Node::ownerDocument() const
+    {
+        return document_;
+    }
+    void Node::ownerDocument(const std::shared_ptr<Document>& document)
+    {
+        if (document != document_) {
+            // The whole subtree belongs to one document, so it moves as a whole:
+            MemoryAccount::Usage usage = subtreeMemoryUsage();
+            if (document) {
+                document->memory().charge(usage);
+            }
+            if (document_) {
+                document_->memory().release(usage);
+            }
+        }
+        // Walk the subtree in document order:
+        Node* node = this;
+        while (node) {
+            std::shared_ptr<Document> previous = std::move(node->document_);
+            node->document_ = document;
+            if (node->indexed_ && previous != document) {
+                // The index moves along, unless there is no document to keep it:
+                std::unique_ptr<ChildIndex> index = previous->releaseChildIndex(node);
+                if (document) {
+                    document->childIndex(node, std::move(index));
+                } else {
+                    node->indexed_ = false;
+                }
+            }
+            node->adopted(previous.get());
+            if (node->first_child_) {
+                node = node->first_child_;
+                continue;
+            }
+            while (node != this && !node->next_sibling_) {
+                node = node->parent_;
+            }
+            node = node == this ? nullptr : node->next_sibling_;
+        }
+    }
+    uint64_t Node::summary() const
+    {
+        return summary_;
+    }
+    void Node::summarize(uint64_t bits)
+    {
+        // A summary always includes those of the descendants, so the walk
+        // stops at the first ancestor that already has all the bits:
+        Node* node = this;
+        while (node && (node->summary_ & bits) != bits) {
+            node->summary_ |= bits;
+            node = node->parent_;
+        }
+    }
+    bool Node::precedes(const Node& other) const
+    {
+        return order_ < other.order_;
+    }
+    void Node::sortInDocumentOrder(std::vector<Node*>& nodes)
+    {
+        if (nodes.size() < RADIX_SORT_THRESHOLD) {
+            std::stable_sort(nodes.begin(), nodes.end(), [](const Node* a, const Node* b) {
+                return a->order_ < b->order_;
+            });
+        } else {
+            // LSD radix sort on the labels, a byte at a time; the bytes that
+            // all labels share (most of the high ones) are skipped:
+            std::vector<Node*> buffer(nodes.size());
+            for (int shift = 0; shift < 64; shift += 8) {
+                size_t counts[256] = {0};
+                for (Node* node: nodes) {
+                    ++counts[(node->order_ >> shift) & 0xff];
+                }
+                if (counts[(nodes.front()->order_ >> shift) & 0xff] == nodes.size()) {
+                    continue;
+                }
+                size_t offset = 0;
+                for (size_t& count: counts) {
+                    size_t n = count;
+                    count = offset;
+                    offset += n;
+                }
+                for (Node* node: nodes) {
+                    buffer[counts[(node->order_ >> shift) & 0xff]++] = node;
+                }
+                nodes.swap(buffer);
+            }
+        }
+        // Duplicates are now in the same run of equal labels (which has more
+        // than one node only for nodes of different trees):
+        auto out = nodes.begin();
+        for (auto run = nodes.begin(); run != nodes.end();) {
+            auto run_end = run;
+            while (run_end != nodes.end() && (*run_end)->order_ == (*run)->order_) {
+                ++run_end;
+            }
+            auto run_out = out;
+            for (auto it = run; it != run_end; ++it) {
+                if (std::find(run_out, out, *it) == out) {
+                    *out++ = *it;
+                }
+            }
+            run = run_end;
+        }
+        nodes.erase(out, nodes.end());
+    }
+    void Node::labeled(Node* node)
+    {
+        // Labels are assigned to the nodes between the preorder neighbours
+        // of the new subtree, evenly spaced. When there is no room, the range
+        // grows over more neighbours (doubling their number) until the labels
+        // are sparse enough, and is relabeled as a whole.
+        auto preceding = [](Node* n) -> Node* {
+            if (Node* prev = n->prevSibling()) {
+                while (prev->first_child_) {
+                    prev = prev->lastChild();
+                }
+                return prev;
+            }
+            return n->parent_;
+        };
+        auto following = [](Node* n, bool into_children) -> Node* {
+            if (into_children && n->first_child_) {
+                return n->first_child_;
+            }
+            while (n && !n->next_sibling_) {
+                n = n->parent_;
+            }
+            return n ? n->next_sibling_ : nullptr;
+        };
+
+        size_t count = 1; // nodes of the range
+        for (auto it = node->descendants().begin(), end = node->descendants().end(); it != end; ++it) {
+            ++count;
+        }
+        Node* low = preceding(node); // the range is between `low` and `high`, both excluded
+        Node* high = following(node, false);
+        for (;;) {
+            uint64_t low_label = low ? low->order_ : 0;
+            uint64_t high_label = high ? high->order_ : MAX_LABEL;
+            uint64_t span = high_label > low_label ? high_label - low_label : 0;
+            uint64_t gap = span / (count + 1);
+            if (gap > 1 && (gap > std::min<uint64_t>(count, LABEL_STEP) || (!low && !high))) {
+                // Appended nodes leave room after them for the next ones:
+                gap = high ? gap : std::min(gap, LABEL_STEP);
+                Node* n = node;
+                if (low) {
+                    n = following(low, true);
+                } else {
+                    while (n->parent_) {
+                        n = n->parent_;
+                    }
+                    n = n->firstSibling();
+                }
+                uint64_t label = low_label;
+                for (; n != high; n = following(n, true)) {
+                    label += gap;
+                    n->order_ = label;
+                }
+                return;
+            }
+            // Widen the range by as many neighbours as it has nodes, on each side:
+            size_t grow = count;
+            for (size_t i = 0; i < grow && low; ++i) {
+                low = preceding(low);
+                ++count;
+            }
+            for (size_t i = 0; i < grow && high; ++i) {
+                high = following(high, true);
+                ++count;
+            }
+        }
+    }
+    void Node::linked(Node* node)
+    {
+        labeled(node);
+        if (ChildIndex* child_index = node->parent_ ? node->parent_->childIndex() : nullptr) {
+            size_t before = child_index->bytes();
+            child_index->insert(node);
+            node->parent_->account(MemoryAccount::DOCUMENT, before, child_index->bytes());
+        }
+    }
+    Journal* Node::journal() const
+    {
+        return document_ ? document_->journal() : nullptr;
+    }
+    void Node::adopted(Document*)
+    {}
+    void Node::changed()
+    {
+        if (document_) {
+            document_->touch();
+        }
+    }
+    MemoryAccount::Usage Node::subtreeMemoryUsage() const
+    {
+        MemoryAccount::Usage usage = {};
+        memoryUsage(usage);
+        for (Node& node: descendants()) {
+            node.memoryUsage(usage);
+        }
+        return usage;
+    }
+    void Node::admit(const Node* node) const
+    {
+        if (document_ && node->document_ != document_) {
+            document_->memory().check(MemoryAccount::total(node->subtreeMemoryUsage()));
+        }
+    }
+    void Node::adopt(Node* node) const
+    {
+        if (node->document_ != document_) {
+            node->ownerDocument(document_);
+        }
+    }
+    void Node::charge()
+    {
+        if (document_) {
+            MemoryAccount::Usage usage = {};
+            memoryUsage(usage);
+            document_->memory().charge(usage);
+        }
+    }
+    void Node::release()
+    {
+        if (document_) {
+            MemoryAccount::Usage usage = {};
+            memoryUsage(usage);
+            document_->memory().release(usage);
+        }
+    }
+    void Node::charge(MemoryAccount::Category category, size_t old_bytes, size_t new_bytes)
+    {
+        if (!document_) {
+            return;
+        }
+        if (new_bytes > old_bytes) {
+            document_->memory().charge(category, new_bytes - old_bytes);
+        } else {
+            document_->memory().release(category, old_bytes - new_bytes);
+        }
+    }
+    void Node::account(MemoryAccount::Category category, size_t old_bytes, size_t new_bytes)
+    {
+        if (document_) {
+            document_->memory().adjust(category, old_bytes, new_bytes);
+        }
+    }
     std::ostream& operator<<(std::ostream& out, const Node& node)
     {
-        out << node.serialize();
+        OStreamWriter writer(out);
+        node.serialize(writer);
         return out;
     }
 }
@@ -1,31 +1,59 @@
 #ifndef _NODE_H
 #define _NODE_H
 
+#include <cstdint>
 #include <string>
 #include <list>
+#include <vector>
 #include <memory>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include "attribute_value.h"
+#include "child_index.h"
+#include "memory_account.h"
 
 namespace SeeQuery
 {
     constexpr size_t INDENT_WIDTH = 2; // 2 spaces
 
+    class Document;
+    class Journal;
+    class Writer;
+    class ChildIterator;
+    class DescendantIterator;
+    template <class Iterator> class NodeRange;
+
     class Node
     {
     public:
+        /* Node types, numbered as in the DOM: */
+        enum NodeType {
+            ELEMENT_NODE = 1,
+            TEXT_NODE = 3
+        };
+
         virtual ~Node();
 
+        virtual int nodeType() const = 0; /** Get the type of this node (`ELEMENT_NODE` or `TEXT_NODE`) */
+
         virtual Node* getElementById(const std::string& id) = 0;
         virtual std::list<Node*> getElementsByTagName(const std::string& tag_name) = 0;
         virtual std::list<Node*> getElementsByClassName(const std::string& class_name) = 0;
         virtual std::list<Node*> getChildren() const;
+        NodeRange<ChildIterator> childNodes() const; /** Iterate over the children without allocating */
+        NodeRange<DescendantIterator> descendants() const; /** Iterate over the descendants in document order */
 
         virtual Node* clone() const = 0; /** Performs deep copy of the current node */
 
-        virtual std::string serialize(size_t depth = 0) const = 0; /** Serialize the node */
-        virtual std::string text() const = 0; /** Get test content of the node */
+        virtual std::string serialize(size_t depth = 0) const; /** Serialize the node */
+        virtual void serialize(Writer& out, size_t depth = 0) const = 0; /** Serialize the node into `out` */
+        virtual std::string text() const = 0; /** Get the text of the node and its descendants, as the DOM `textContent` */
         virtual std::string html() const = 0; /** Get HTML content of the node */
         virtual std::string attr(const std::string& key) const = 0; /** Get attribute value for the given key */
         virtual void attr(const std::string& key, const std::string& value) = 0; /** Set attribute value for the given key */
+        virtual AttributeValue attrValue(const std::string& key) const = 0; /** Get typed attribute value for the given key */
+        virtual void attr(const std::string& key, const AttributeValue& value) = 0; /** Set typed attribute value for the given key */
 
         virtual Node* append(Node* child) = 0; /** Append child node */
         virtual Node* prepend(Node* child) = 0; /** Prepend child node */
@@ -51,16 +79,200 @@ namespace SeeQuery
         virtual Node* firstChild() const; /** Get the first child of this node */
         virtual Node* lastChild() const; /** Get the last child of this node */
 
+        /**
+         * Keep a positional index of the children (see `ChildIndex`), so that
+         * `childCount()`, `childAt()`, `insertChild()` and the `index()` of
+         * the children take O(log n) instead of O(n). Worth it for nodes with
+         * many children addressed by position. The index is kept by the
+         * document (nodes only carry a flag), so the node must have one:
+         * throws `std::logic_error` otherwise. A node moved out of all
+         * documents loses its index.
+         */
+        void indexChildren(bool enable = true);
+        bool indexesChildren() const; /** Return true if the children are indexed */
+        size_t childCount() const; /** Get the number of children */
+        Node* childAt(size_t index) const; /** Get the child at `index`, null if out of range */
+        size_t index() const; /** Get the position of this node among its siblings */
+        Node* insertChild(size_t index, Node* child); /** Insert `child` before the child at `index`, or at the end */
+
         virtual bool isFirst() const; /** Return true if this node is the first sibling, otherwise false */
         virtual bool isLast() const; /** Return true if this node is the last sibling, otherwise false */
 
         virtual Node* detach(); /** Detach this node from its emplacement */
+
+        const std::shared_ptr<Document>& ownerDocument() const; /** Get the document of this node, null if none */
+        /**
+         * Move this node and its subtree to `document`, moving their bytes
+         * to its memory account; throws `MemoryBudgetExceeded` before any
+         * change if they exceed its budget.
+         */
+        void ownerDocument(const std::shared_ptr<Document>& document);
+        /** Add the bytes held by this node (not its descendants) to `usage`, see `MemoryAccount` */
+        virtual void memoryUsage(MemoryAccount::Usage& usage) const = 0;
+        MemoryAccount::Usage subtreeMemoryUsage() const; /** Get the bytes held by this node and its descendants */
+
+        /**
+         * Get the summary of the tags and classes of this node and its
+         * descendants: a 64-bit bloom filter. A clear bit proves the subtree
+         * has no match, so queries skip it. Bits are only ever added (when a
+         * node is inserted or an attribute set), so after removals the
+         * summary may be a superset, which costs a needless visit at worst.
+         * Ids are unique, so they would fill the summaries of the ancestors;
+         * they are looked up in the document instead.
+         */
+        uint64_t summary() const;
+
+        /**
+         * Return true if this node comes before `other` in document order.
+         * Nodes carry order labels, increasing in document order within a
+         * tree and maintained when nodes are inserted, so this takes constant
+         * time. Nodes of different trees compare in an arbitrary (but
+         * consistent) order.
+         */
+        bool precedes(const Node& other) const;
+        /** Sort `nodes` in document order and drop duplicates, in linear time */
+        static void sortInDocumentOrder(std::vector<Node*>& nodes);
+    protected:
+        void admit(const Node* node) const; /** Throw `MemoryBudgetExceeded` if `node` cannot move to the document of this node */
+        void adopt(Node* node) const; /** Move `node` to the document of this node, if it differs */
+        void charge(); /** Charge the bytes of this node to the document, see `memoryUsage()` */
+        void release(); /** Release the bytes of this node from the document */
+        /** Account for `category` going from `old_bytes` to `new_bytes`; throws before any change when over budget */
+        void charge(MemoryAccount::Category category, size_t old_bytes, size_t new_bytes);
+        /** As `charge()`, for state derived from an admitted change: never throws */
+        void account(MemoryAccount::Category category, size_t old_bytes, size_t new_bytes);
+        void summarize(uint64_t bits); /** Add `bits` to the summary of this node and its ancestors */
+        Journal* journal() const; /** Get the mutation journal of the document, null if none */
+        void changed(); /** Bump the generation of the document, if any */
+        /** Update state kept per document after this node moved from `previous` (null if none) */
+        virtual void adopted(Document* previous);
+        void linked(Node* node); /** Update the order labels and the index after `node` was linked */
+        std::shared_ptr<Document> document_;
     private:
+        friend class Collection;
+        std::atomic<int> root_refs_{0}; // number of collection references while this node is a root
+        bool indexed_ = false; // the document has a `ChildIndex` of the children; fills padding
+
         Node* parent_ = nullptr;
         Node* next_sibling_ = nullptr;
         // `prev_sibling` will always point to the last element in order to speed up appending:
         Node* prev_sibling_ = this;
         Node* first_child_ = nullptr;
+        uint64_t summary_ = 0;
+        uint64_t order_ = 0; // document order label, see `precedes()`
+
+        ChildIndex* childIndex() const; /** Get the index of the children, null unless `indexChildren()` */
+        void labeled(Node* node); /** Label `node` and its subtree after it was linked into a tree */
+    };
+
+    /**
+     * Bidirectional iterator over the children of a node, following the
+     * sibling links; `end()` is one past the last child.
+     */
+    class ChildIterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef Node value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Node* pointer;
+        typedef Node& reference;
+
+        ChildIterator(const Node* parent = nullptr, Node* node = nullptr) :
+            parent_(parent),
+            node_(node)
+        {}
+        reference operator*() const { return *node_; }
+        pointer operator->() const { return node_; }
+        ChildIterator& operator++()
+        {
+            node_ = node_->nextSibling();
+            return *this;
+        }
+        ChildIterator operator++(int)
+        {
+            ChildIterator old = *this;
+            ++*this;
+            return old;
+        }
+        ChildIterator& operator--()
+        {
+            // Stepping back from `end()` gets the last child:
+            node_ = node_ ? node_->prevSibling() : parent_->lastChild();
+            return *this;
+        }
+        ChildIterator operator--(int)
+        {
+            ChildIterator old = *this;
+            --*this;
+            return old;
+        }
+        bool operator==(const ChildIterator& other) const { return node_ == other.node_; }
+        bool operator!=(const ChildIterator& other) const { return node_ != other.node_; }
+    private:
+        const Node* parent_;
+        Node* node_;
+    };
+
+    /**
+     * Forward iterator over the descendants of a node in document order
+     * (the node itself excluded).
+     */
+    class DescendantIterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Node value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Node* pointer;
+        typedef Node& reference;
+
+        DescendantIterator(const Node* root = nullptr, Node* node = nullptr) :
+            root_(root),
+            node_(node)
+        {}
+        reference operator*() const { return *node_; }
+        pointer operator->() const { return node_; }
+        DescendantIterator& operator++()
+        {
+            if (Node* child = node_->firstChild()) {
+                node_ = child;
+                return *this;
+            }
+            while (node_->parent() != root_ && !node_->nextSibling()) {
+                node_ = node_->parent();
+            }
+            node_ = node_->nextSibling(); // null after the last child of the root
+            return *this;
+        }
+        DescendantIterator operator++(int)
+        {
+            DescendantIterator old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const DescendantIterator& other) const { return node_ == other.node_; }
+        bool operator!=(const DescendantIterator& other) const { return node_ != other.node_; }
+    private:
+        const Node* root_;
+        Node* node_;
+    };
+
+    /** Pair of iterators usable with range-for */
+    template <class Iterator>
+    class NodeRange
+    {
+    public:
+        NodeRange(Iterator begin, Iterator end) :
+            begin_(begin),
+            end_(end)
+        {}
+        Iterator begin() const { return begin_; }
+        Iterator end() const { return end_; }
+        bool empty() const { return begin_ == end_; }
+    private:
+        Iterator begin_;
+        Iterator end_;
     };
 
     std::ostream& operator<<(std::ostream& out, const Node& node);
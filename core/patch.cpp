@@ -0,0 +1,720 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include "patch.h"
+#include "html_node.h"
+#include "text_node.h"
+#include "writer.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        typedef std::vector<size_t> Path;
+        typedef std::unordered_map<const Node*, uint64_t> Hashes;
+
+        uint64_t combine(uint64_t seed, uint64_t value)
+        {
+            return seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+        }
+        /* Node name as in the DOM: the tag name or "#text": */
+        std::string name_of(const Node& node)
+        {
+            return node.nodeType() == Node::ELEMENT_NODE
+                ? static_cast<const HtmlNode&>(node).tagName()
+                : std::string("#text");
+        }
+        std::string key_of(const Node& node)
+        {
+            return node.nodeType() == Node::ELEMENT_NODE ? node.attr("id") : std::string();
+        }
+        std::vector<Node*> children_of(const Node& node)
+        {
+            std::vector<Node*> children;
+            for (Node* child = node.firstChild(); child; child = child->nextSibling()) {
+                children.push_back(child);
+            }
+            return children;
+        }
+
+        /* Structural hash of every node of the subtree of `node`: */
+        uint64_t hash_tree(const Node& node, Hashes& hashes)
+        {
+            std::hash<std::string> hash;
+            uint64_t result = hash(name_of(node));
+            if (node.nodeType() == Node::ELEMENT_NODE) {
+                // Attributes are unordered, so their hashes are summed:
+                uint64_t attributes = 0;
+                for (auto& attr: static_cast<const HtmlNode&>(node).attributes()) {
+                    attributes += combine(hash(attr.first), hash(attr.second.str()));
+                }
+                result = combine(result, attributes);
+                for (Node* child = node.firstChild(); child; child = child->nextSibling()) {
+                    result = combine(result, hash_tree(*child, hashes));
+                }
+            } else {
+                result = combine(result, hash(static_cast<const TextNode&>(node).text()));
+            }
+            hashes[&node] = result;
+            return result;
+        }
+        bool equal(const Node& a, const Node& b)
+        {
+            if (a.nodeType() != b.nodeType()) {
+                return false;
+            }
+            if (a.nodeType() != Node::ELEMENT_NODE) {
+                return static_cast<const TextNode&>(a).text() == static_cast<const TextNode&>(b).text();
+            }
+            auto& x = static_cast<const HtmlNode&>(a);
+            auto& y = static_cast<const HtmlNode&>(b);
+            if (x.tagName() != y.tagName() || x.attributes().size() != y.attributes().size()) {
+                return false;
+            }
+            for (auto& attr: x.attributes()) {
+                auto it = y.attributes().find(attr.first);
+                if (it == y.attributes().end() || it->second != attr.second) {
+                    return false;
+                }
+            }
+            Node* c = a.firstChild();
+            Node* d = b.firstChild();
+            for (; c && d; c = c->nextSibling(), d = d->nextSibling()) {
+                if (!equal(*c, *d)) {
+                    return false;
+                }
+            }
+            return !c && !d;
+        }
+
+        /* Indices (into `sequence`) of a longest increasing subsequence, skipping negatives: */
+        std::vector<bool> increasing_run(const std::vector<long>& sequence)
+        {
+            std::vector<size_t> tails; // index of the smallest tail of a run of each length
+            std::vector<long> previous(sequence.size(), -1);
+            for (size_t j = 0; j < sequence.size(); ++j) {
+                if (sequence[j] < 0) {
+                    continue;
+                }
+                auto it = std::lower_bound(tails.begin(), tails.end(), sequence[j],
+                    [&](size_t k, long value) { return sequence[k] < value; });
+                if (it != tails.begin()) {
+                    previous[j] = static_cast<long>(*(it - 1));
+                }
+                if (it == tails.end()) {
+                    tails.push_back(j);
+                } else {
+                    *it = j;
+                }
+            }
+            std::vector<bool> result(sequence.size(), false);
+            long j = tails.empty() ? -1 : static_cast<long>(tails.back());
+            while (j >= 0) {
+                result[j] = true;
+                j = previous[j];
+            }
+            return result;
+        }
+
+        Node* child_at(Node* parent, size_t index)
+        {
+            Node* child = parent->firstChild();
+            while (child && index--) {
+                child = child->nextSibling();
+            }
+            if (!child) {
+                throw std::out_of_range("Patch: no node at path");
+            }
+            return child;
+        }
+        Node* resolve(Node& root, const Path& path, size_t length)
+        {
+            Node* node = &root;
+            for (size_t i = 0; i < length; ++i) {
+                node = child_at(node, path[i]);
+            }
+            return node;
+        }
+        /* Insert `node` as child `index` of `parent`: */
+        void insert(Node* parent, size_t index, Node* node)
+        {
+            if (index > 0) {
+                child_at(parent, index - 1)->nextSibling(node);
+            } else {
+                parent->prepend(node);
+            }
+        }
+
+        void write_path(Writer& out, const Path& path)
+        {
+            for (size_t i = 0; i < path.size(); ++i) {
+                if (i) {
+                    out.write(".", 1);
+                }
+                out.write(std::to_string(path[i]));
+            }
+        }
+        /* Characters escaped besides tabs, newlines and backslashes, by context: */
+        const char* const FIELD = "";
+        const char* const NAME = " =/>";
+        const char* const VALUE = "\"";
+        const char* const TEXT = "<";
+        /* Separates adjacent text nodes in markup and marks empty ones: */
+        const char TEXT_BREAK[] = "\\|";
+
+        void write_escaped(Writer& out, const std::string& s, const char* special = FIELD)
+        {
+            size_t begin = 0;
+            for (size_t i = 0; i < s.size(); ++i) {
+                char c = s[i];
+                if (c == '\t' || c == '\n' || c == '\\' || std::strchr(special, c)) {
+                    char escape[] = {'\\', c == '\t' ? 't' : c == '\n' ? 'n' : c};
+                    out.write(s.data() + begin, i - begin);
+                    out.write(escape, 2);
+                    begin = i + 1;
+                }
+            }
+            out.write(s.data() + begin, s.size() - begin);
+        }
+        /* Markup without the indentation of `Node::serialize()`: */
+        void write_compact(Writer& out, const Node& node)
+        {
+            if (node.nodeType() != Node::ELEMENT_NODE) {
+                write_escaped(out, static_cast<const TextNode&>(node).text(), TEXT);
+                return;
+            }
+            auto& element = static_cast<const HtmlNode&>(node);
+            out.write("<", 1);
+            write_escaped(out, element.tagName(), NAME);
+            for (auto& attr: element.attributes()) {
+                out.write(" ", 1);
+                write_escaped(out, attr.first, NAME);
+                out.write("=\"", 2);
+                write_escaped(out, attr.second.str(), VALUE);
+                out.write("\"", 1);
+            }
+            if (!node.firstChild()) {
+                out.write("/>", 2);
+                return;
+            }
+            out.write(">", 1);
+            bool after_text = false;
+            for (Node* child = node.firstChild(); child; child = child->nextSibling()) {
+                bool text = child->nodeType() != Node::ELEMENT_NODE;
+                if (text && (after_text || static_cast<const TextNode*>(child)->text().empty())) {
+                    out.write(TEXT_BREAK, 2);
+                }
+                write_compact(out, *child);
+                after_text = text;
+            }
+            out.write("</", 2);
+            write_escaped(out, element.tagName(), NAME);
+            out.write(">", 1);
+        }
+
+        /* Reads the compact form back, see `Patch::serialize()`: */
+        class Reader
+        {
+        public:
+            Reader(const std::string& text) :
+                text_(text),
+                pos_(0)
+            {
+            }
+            bool done() const
+            {
+                return pos_ == text_.size();
+            }
+            Edit edit()
+            {
+                static const char OPERATIONS[] = "+->=!~";
+                const char* operation = std::strchr(OPERATIONS, next());
+                if (!operation || !*operation) {
+                    fail("unknown operation");
+                }
+                Edit e;
+                e.type = static_cast<Edit::Type>(operation - OPERATIONS);
+                if (e.type == Edit::MOVE) {
+                    e.from = path();
+                    expect('\t');
+                }
+                e.path = path();
+                switch (e.type) {
+                case Edit::INSERT:
+                    expect('\t');
+                    e.node.reset(node());
+                    break;
+                case Edit::SET_ATTRIBUTE:
+                    expect('\t');
+                    e.key = field(FIELD);
+                    expect('\t');
+                    e.value = AttributeValue(field(FIELD));
+                    break;
+                case Edit::REMOVE_ATTRIBUTE:
+                    expect('\t');
+                    e.key = field(FIELD);
+                    break;
+                case Edit::SET_TEXT:
+                    expect('\t');
+                    e.value = AttributeValue(field(FIELD));
+                    break;
+                default:
+                    break;
+                }
+                // The root can only be edited in place:
+                bool moves = e.type == Edit::INSERT || e.type == Edit::REMOVE || e.type == Edit::MOVE;
+                if (moves && (e.path.empty() || (e.type == Edit::MOVE && e.from.empty()))) {
+                    fail("the root cannot be inserted, removed or moved");
+                }
+                expect('\n');
+                return e;
+            }
+        private:
+            [[noreturn]] void fail(const char* what) const
+            {
+                throw std::invalid_argument(std::string("Patch: ") + what + " at offset " + std::to_string(pos_));
+            }
+            char peek() const
+            {
+                return pos_ < text_.size() ? text_[pos_] : '\0';
+            }
+            char next()
+            {
+                if (done()) {
+                    fail("unexpected end");
+                }
+                return text_[pos_++];
+            }
+            bool at(const char* s) const
+            {
+                return text_.compare(pos_, std::strlen(s), s) == 0;
+            }
+            void expect(char c)
+            {
+                if (next() != c) {
+                    --pos_;
+                    fail("unexpected character");
+                }
+            }
+            Path path()
+            {
+                Path path;
+                if (peek() < '0' || peek() > '9') {
+                    return path;
+                }
+                while (true) {
+                    size_t index = 0;
+                    if (peek() < '0' || peek() > '9') {
+                        fail("bad path");
+                    }
+                    while (peek() >= '0' && peek() <= '9') {
+                        index = index * 10 + static_cast<size_t>(next() - '0');
+                    }
+                    path.push_back(index);
+                    if (peek() != '.') {
+                        return path;
+                    }
+                    ++pos_;
+                }
+            }
+            /* Unescape up to a tab, a newline or an unescaped `special` character: */
+            std::string field(const char* special)
+            {
+                std::string result;
+                char c;
+                while ((c = peek()) != '\0' && c != '\t' && c != '\n' && !std::strchr(special, c)) {
+                    ++pos_;
+                    if (c == '\\') {
+                        if (at("|")) {
+                            --pos_; // a text break, see `TEXT_BREAK`
+                            break;
+                        }
+                        c = next();
+                        c = c == 't' ? '\t' : c == 'n' ? '\n' : c;
+                    }
+                    result.push_back(c);
+                }
+                return result;
+            }
+            Node* node()
+            {
+                if (peek() != '<') {
+                    return new TextNode(field(TEXT));
+                }
+                ++pos_;
+                std::unique_ptr<HtmlNode> element(new HtmlNode(field(NAME)));
+                if (element->tagName().empty()) {
+                    fail("missing tag name");
+                }
+                while (peek() == ' ') {
+                    ++pos_;
+                    std::string key = field(NAME);
+                    expect('=');
+                    expect('"');
+                    element->attr(key, field(VALUE));
+                    expect('"');
+                }
+                if (at("/>")) {
+                    pos_ += 2;
+                    return element.release();
+                }
+                expect('>');
+                bool after_text = false;
+                while (!at("</")) {
+                    if (at(TEXT_BREAK)) {
+                        pos_ += 2;
+                        element->append(new TextNode(field(TEXT)));
+                        after_text = true;
+                    } else if (peek() == '<') {
+                        element->append(node());
+                        after_text = false;
+                    } else if (!after_text && peek() != '\t' && peek() != '\n' && !done()) {
+                        element->append(new TextNode(field(TEXT)));
+                        after_text = true;
+                    } else {
+                        fail("unterminated element");
+                    }
+                }
+                pos_ += 2;
+                if (field(NAME) != element->tagName()) {
+                    fail("mismatched closing tag");
+                }
+                expect('>');
+                return element.release();
+            }
+
+            const std::string& text_;
+            size_t pos_;
+        };
+
+        /**
+         * Computes the edits while applying them to a working copy of the old
+         * tree, so every path refers to the tree as left by earlier edits.
+         */
+        class Differ
+        {
+        public:
+            Differ(std::vector<Edit>& edits, const Node& from, const Node& to) :
+                edits_(edits),
+                work_(from.clone())
+            {
+                hash_tree(*work_, old_hashes_);
+                hash_tree(to, new_hashes_);
+            }
+            void run(const Node& to)
+            {
+                if (name_of(*work_) != name_of(to)) {
+                    throw std::invalid_argument("Patch: roots differ");
+                }
+                Path path;
+                node(work_.get(), to, path);
+            }
+        private:
+            void node(Node* a, const Node& b, Path& path)
+            {
+                if (old_hashes_[a] == new_hashes_[&b] && equal(*a, b)) {
+                    return; // identical subtrees
+                }
+                if (a->nodeType() != Node::ELEMENT_NODE) {
+                    std::string text = static_cast<const TextNode&>(b).text();
+                    if (static_cast<TextNode*>(a)->text() != text) {
+                        static_cast<TextNode*>(a)->text(text);
+                        edit(Edit::SET_TEXT, path).value = AttributeValue(text);
+                    }
+                    return;
+                }
+                auto& x = *static_cast<HtmlNode*>(a);
+                auto& y = static_cast<const HtmlNode&>(b);
+                std::vector<std::string> removed;
+                for (auto& attr: x.attributes()) {
+                    if (!y.attributes().count(attr.first)) {
+                        removed.push_back(attr.first);
+                    }
+                }
+                for (auto& key: removed) {
+                    x.removeAttr(key);
+                    edit(Edit::REMOVE_ATTRIBUTE, path).key = key;
+                }
+                for (auto& attr: y.attributes()) {
+                    auto it = x.attributes().find(attr.first);
+                    if (it == x.attributes().end() || it->second != attr.second) {
+                        x.attr(attr.first, attr.second);
+                        Edit& e = edit(Edit::SET_ATTRIBUTE, path);
+                        e.key = attr.first;
+                        e.value = attr.second;
+                    }
+                }
+                children(a, b, path);
+            }
+            void children(Node* a, const Node& b, Path& path)
+            {
+                std::vector<Node*> old_children = children_of(*a);
+                std::vector<Node*> new_children = children_of(b);
+                std::vector<long> match(new_children.size(), -1); // old index of each new child
+                std::vector<bool> used(old_children.size(), false);
+                std::vector<std::string> old_keys, new_keys;
+                for (Node* child: old_children) {
+                    old_keys.push_back(key_of(*child));
+                }
+                for (Node* child: new_children) {
+                    new_keys.push_back(key_of(*child));
+                }
+
+                // Keyed children match the old child with the same id and tag:
+                std::unordered_map<std::string, size_t> keyed;
+                for (size_t i = 0; i < old_children.size(); ++i) {
+                    if (!old_keys[i].empty()) {
+                        keyed.insert(std::make_pair(old_keys[i], i));
+                    }
+                }
+                for (size_t j = 0; j < new_children.size(); ++j) {
+                    if (new_keys[j].empty()) {
+                        continue;
+                    }
+                    auto it = keyed.find(new_keys[j]);
+                    if (it != keyed.end() && !used[it->second]
+                            && name_of(*old_children[it->second]) == name_of(*new_children[j])) {
+                        match[j] = static_cast<long>(it->second);
+                        used[it->second] = true;
+                    }
+                }
+                // Other children match an identical subtree, else the next one with the same name:
+                std::unordered_map<uint64_t, std::deque<size_t>> by_hash;
+                for (size_t i = 0; i < old_children.size(); ++i) {
+                    if (old_keys[i].empty()) {
+                        by_hash[old_hashes_[old_children[i]]].push_back(i);
+                    }
+                }
+                for (size_t j = 0; j < new_children.size(); ++j) {
+                    if (!new_keys[j].empty()) {
+                        continue;
+                    }
+                    auto it = by_hash.find(new_hashes_[new_children[j]]);
+                    if (it == by_hash.end()) {
+                        continue;
+                    }
+                    for (auto i = it->second.begin(); i != it->second.end(); ++i) {
+                        if (!used[*i] && equal(*old_children[*i], *new_children[j])) {
+                            match[j] = static_cast<long>(*i);
+                            used[*i] = true;
+                            it->second.erase(i);
+                            break;
+                        }
+                    }
+                }
+                std::unordered_map<std::string, std::deque<size_t>> by_name;
+                for (size_t i = 0; i < old_children.size(); ++i) {
+                    if (old_keys[i].empty() && !used[i]) {
+                        by_name[name_of(*old_children[i])].push_back(i);
+                    }
+                }
+                for (size_t j = 0; j < new_children.size(); ++j) {
+                    if (!new_keys[j].empty() || match[j] >= 0) {
+                        continue;
+                    }
+                    auto& candidates = by_name[name_of(*new_children[j])];
+                    while (!candidates.empty() && used[candidates.front()]) {
+                        candidates.pop_front();
+                    }
+                    if (!candidates.empty()) {
+                        match[j] = static_cast<long>(candidates.front());
+                        used[candidates.front()] = true;
+                        candidates.pop_front();
+                    }
+                }
+
+                // Remove unmatched old children, from the last so indices stay valid:
+                std::vector<Node*> current = old_children;
+                for (size_t i = old_children.size(); i-- > 0;) {
+                    if (!used[i]) {
+                        path.push_back(i);
+                        edit(Edit::REMOVE, path);
+                        path.pop_back();
+                        current.erase(current.begin() + i);
+                        delete old_children[i]->detach();
+                    }
+                }
+
+                // Place the others right to left, each before its successor;
+                // the children in the longest increasing run stay in place:
+                std::vector<bool> stable = increasing_run(match);
+                std::vector<Node*> placed(new_children.size(), nullptr);
+                for (size_t j = 0; j < new_children.size(); ++j) {
+                    if (match[j] >= 0) {
+                        placed[j] = old_children[match[j]];
+                    }
+                }
+                for (size_t j = new_children.size(); j-- > 0;) {
+                    if (stable[j]) {
+                        continue;
+                    }
+                    Node* anchor = j + 1 < new_children.size() ? placed[j + 1] : nullptr;
+                    if (placed[j]) {
+                        size_t from = index_of(current, placed[j]);
+                        current.erase(current.begin() + from);
+                        placed[j]->detach();
+                        size_t to = anchor ? index_of(current, anchor) : current.size();
+                        put(a, current, to, placed[j]);
+                        Edit& e = edit(Edit::MOVE, path);
+                        e.from = path;
+                        e.from.push_back(from);
+                        e.path.push_back(to);
+                    } else {
+                        placed[j] = new_children[j]->clone();
+                        size_t to = anchor ? index_of(current, anchor) : current.size();
+                        put(a, current, to, placed[j]);
+                        Edit& e = edit(Edit::INSERT, path);
+                        e.path.push_back(to);
+                        e.node.reset(new_children[j]->clone());
+                    }
+                }
+
+                // Children are in their final places now; descend into the matched ones:
+                for (size_t j = 0; j < new_children.size(); ++j) {
+                    if (match[j] >= 0) {
+                        path.push_back(j);
+                        node(placed[j], *new_children[j], path);
+                        path.pop_back();
+                    }
+                }
+            }
+
+            static size_t index_of(const std::vector<Node*>& nodes, Node* node)
+            {
+                return static_cast<size_t>(std::find(nodes.begin(), nodes.end(), node) - nodes.begin());
+            }
+            static void put(Node* parent, std::vector<Node*>& current, size_t index, Node* node)
+            {
+                if (index < current.size()) {
+                    current[index]->prevSibling(node);
+                } else {
+                    parent->append(node);
+                }
+                current.insert(current.begin() + index, node);
+            }
+            Edit& edit(Edit::Type type, const Path& path)
+            {
+                edits_.push_back(Edit());
+                edits_.back().type = type;
+                edits_.back().path = path;
+                return edits_.back();
+            }
+
+            std::vector<Edit>& edits_;
+            std::unique_ptr<Node> work_;
+            Hashes old_hashes_;
+            Hashes new_hashes_;
+        };
+    }
+
+    Patch Patch::diff(const Node& from, const Node& to)
+    {
+        Patch patch;
+        Differ differ(patch.edits_, from, to);
+        differ.run(to);
+        return patch;
+    }
+    Patch Patch::parse(const std::string& text)
+    {
+        Patch patch;
+        Reader reader(text);
+        while (!reader.done()) {
+            patch.edits_.push_back(reader.edit());
+        }
+        return patch;
+    }
+    void Patch::apply(Node& root) const
+    {
+        for (auto& e: edits_) {
+            switch (e.type) {
+            case Edit::INSERT:
+                insert(resolve(root, e.path, e.path.size() - 1), e.path.back(), e.node->clone());
+                break;
+            case Edit::REMOVE:
+                delete resolve(root, e.path, e.path.size())->detach();
+                break;
+            case Edit::MOVE:
+            {
+                Node* node = resolve(root, e.from, e.from.size())->detach();
+                insert(resolve(root, e.path, e.path.size() - 1), e.path.back(), node);
+                break;
+            }
+            case Edit::SET_ATTRIBUTE:
+                resolve(root, e.path, e.path.size())->attr(e.key, e.value);
+                break;
+            case Edit::REMOVE_ATTRIBUTE:
+            {
+                Node* node = resolve(root, e.path, e.path.size());
+                if (node->nodeType() == Node::ELEMENT_NODE) {
+                    static_cast<HtmlNode*>(node)->removeAttr(e.key);
+                }
+                break;
+            }
+            case Edit::SET_TEXT:
+            {
+                Node* node = resolve(root, e.path, e.path.size());
+                if (node->nodeType() == Node::TEXT_NODE) {
+                    static_cast<TextNode*>(node)->text(e.value.str());
+                }
+                break;
+            }
+            }
+        }
+    }
+    const std::vector<Edit>& Patch::edits() const
+    {
+        return edits_;
+    }
+    size_t Patch::size() const
+    {
+        return edits_.size();
+    }
+    bool Patch::empty() const
+    {
+        return edits_.empty();
+    }
+    std::string Patch::serialize() const
+    {
+        StringWriter out;
+        serialize(out);
+        return std::move(out.str());
+    }
+    void Patch::serialize(Writer& out) const
+    {
+        static const char OPERATIONS[] = "+->=!~";
+        for (auto& e: edits_) {
+            out.write(&OPERATIONS[e.type], 1);
+            if (e.type == Edit::MOVE) {
+                write_path(out, e.from);
+                out.write("\t", 1);
+            }
+            write_path(out, e.path);
+            switch (e.type) {
+            case Edit::INSERT:
+                out.write("\t", 1);
+                write_compact(out, *e.node);
+                break;
+            case Edit::SET_ATTRIBUTE:
+                out.write("\t", 1);
+                write_escaped(out, e.key);
+                out.write("\t", 1);
+                write_escaped(out, e.value.str());
+                break;
+            case Edit::REMOVE_ATTRIBUTE:
+                out.write("\t", 1);
+                write_escaped(out, e.key);
+                break;
+            case Edit::SET_TEXT:
+                out.write("\t", 1);
+                write_escaped(out, e.value.str());
+                break;
+            default:
+                break;
+            }
+            out.write("\n", 1);
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef _PATCH_H
+#define _PATCH_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "node.h"
+#include "attribute_value.h"
+
+namespace SeeQuery
+{
+    /**
+     * One operation of an edit script. Nodes are addressed by paths of child
+     * indices from the root (the root itself is the empty path), valid in
+     * the tree as left by the preceding edits.
+     */
+    struct Edit
+    {
+        enum Type {
+            INSERT, // insert `node` at `path`
+            REMOVE, // remove the node at `path`
+            MOVE, // move the node at `from` to `path` (taken after the removal)
+            SET_ATTRIBUTE, // set attribute `key` of the element at `path` to `value`
+            REMOVE_ATTRIBUTE, // remove attribute `key` of the element at `path`
+            SET_TEXT // set the text of the text node at `path` to `value`
+        };
+
+        Type type;
+        std::vector<size_t> path;
+        std::vector<size_t> from;
+        std::string key;
+        AttributeValue value;
+        std::shared_ptr<const Node> node;
+    };
+
+    /**
+     * Edit script turning one node tree into another.
+     *
+     * Children are matched by `id` first, then as identical subtrees, then by
+     * tag name in order. Matched children that keep their relative order
+     * (the longest increasing run) stay in place, the others are moved, so
+     * reordering a few children costs a few moves. Identical subtrees are
+     * recognized by a structural hash and skipped without a descent.
+     *
+     *     Patch patch = Patch::diff(old_root, new_root);
+     *     send(patch.serialize()); // compact text form
+     *     patch.apply(replica_root); // replica_root now equals new_root
+     */
+    class Patch
+    {
+    public:
+        /**
+         * Compute the edits turning `from` into `to`. Throws
+         * `std::invalid_argument` if the roots differ in type or tag name,
+         * since the root itself cannot be replaced by a path.
+         */
+        static Patch diff(const Node& from, const Node& to);
+        /**
+         * Read the compact form written by `serialize()`. Throws
+         * `std::invalid_argument` on malformed input.
+         */
+        static Patch parse(const std::string& text);
+
+        void apply(Node& root) const; /** Apply the edits to a tree equal to the `from` of `diff()` */
+
+        const std::vector<Edit>& edits() const;
+        size_t size() const; /** Get the number of edits */
+        bool empty() const;
+
+        /**
+         * Serialize to the compact form: one line per edit, fields separated
+         * by tabs, with tabs, newlines and backslashes escaped by a backslash:
+         *
+         *     +path	<tag a="v">text</tag>
+         *     -path
+         *     >from	path
+         *     =path	key	value
+         *     !path	key
+         *     ~path	text
+         *
+         * Paths are child indices joined by '.', e.g. "1.0.3". In inserted
+         * markup, '<' in text, '"' in attribute values and " =/>" in names
+         * are escaped as well, and "\|" separates adjacent text nodes (or
+         * stands for an empty one), so `parse()` reads back the same tree.
+         */
+        std::string serialize() const;
+        void serialize(Writer& out) const;
+
+    private:
+        std::vector<Edit> edits_;
+    };
+}
+
+#endif // _PATCH_H
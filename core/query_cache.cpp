@@ -0,0 +1,126 @@
+#include <iterator>
+#include "query_cache.h"
+
+namespace SeeQuery
+{
+    constexpr size_t QueryCache::DEFAULT_CAPACITY;
+
+    QueryCache::QueryCache(size_t capacity, MemoryAccount* memory) :
+        memory_(memory),
+        capacity_(capacity)
+    {}
+    QueryCache::~QueryCache()
+    {
+        while (!entries_.empty()) {
+            erase(entries_.begin());
+        }
+    }
+    QueryCache::Result QueryCache::find(const Node* root, const std::string& selector, uint64_t generation)
+    {
+        Result result;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(Key{root, selector});
+            if (it != index_.end() && it->second->generation == generation) {
+                entries_.splice(entries_.begin(), entries_, it->second);
+                result = it->second->nodes;
+            }
+        }
+        if (result) {
+            ++hits_;
+        } else {
+            ++misses_;
+        }
+        return result;
+    }
+    void QueryCache::store(const Node* root, const std::string& selector, uint64_t generation, Result nodes)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Key key{root, selector};
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            // An outdated result, or one stored meanwhile by another thread:
+            erase(it->second);
+        }
+        if (cost(nodes) > capacity_) {
+            return;
+        }
+        Entry entry{key, generation, std::move(nodes)};
+        if (memory_) {
+            try {
+                memory_->charge(MemoryAccount::DOCUMENT, bytes(entry));
+            } catch (const MemoryBudgetExceeded&) {
+                return;
+            }
+        }
+        nodes_ += cost(entry.nodes);
+        entries_.push_front(std::move(entry));
+        index_.emplace(std::move(key), entries_.begin());
+        evict();
+    }
+    size_t QueryCache::capacity() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return capacity_;
+    }
+    void QueryCache::capacity(size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity;
+        evict();
+    }
+    size_t QueryCache::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+    size_t QueryCache::nodes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return nodes_;
+    }
+    size_t QueryCache::hits() const
+    {
+        return hits_;
+    }
+    size_t QueryCache::misses() const
+    {
+        return misses_;
+    }
+    void QueryCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (!entries_.empty()) {
+            erase(entries_.begin());
+        }
+        hits_ = 0;
+        misses_ = 0;
+    }
+    size_t QueryCache::cost(const Result& nodes)
+    {
+        return nodes->size() + 1;
+    }
+    size_t QueryCache::bytes(const Entry& entry)
+    {
+        // The list node, the hash table node (with its copy of the key and a cached hash), the shared vector:
+        const size_t overhead = sizeof(Entry) + 2 * sizeof(void*)
+            + sizeof(std::pair<const Key, std::list<Entry>::iterator>) + 2 * sizeof(void*)
+            + sizeof(std::vector<Node*>) + 2 * sizeof(void*);
+        return overhead + 2 * entry.key.selector.size() + entry.nodes->capacity() * sizeof(Node*);
+    }
+    void QueryCache::erase(std::list<Entry>::iterator it)
+    {
+        nodes_ -= cost(it->nodes);
+        if (memory_) {
+            memory_->release(MemoryAccount::DOCUMENT, bytes(*it));
+        }
+        index_.erase(it->key);
+        entries_.erase(it);
+    }
+    void QueryCache::evict()
+    {
+        while (nodes_ > capacity_) {
+            erase(std::prev(entries_.end()));
+        }
+    }
+}
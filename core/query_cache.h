@@ -0,0 +1,95 @@
+#ifndef _QUERY_CACHE_H
+#define _QUERY_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include "memory_account.h"
+
+namespace SeeQuery
+{
+    class Node;
+
+    /**
+     * Bounded cache of selector query results, keyed by the queried root,
+     * the selector and the generation of the document (see
+     * `Document::generation()`). Any mutation bumps the generation, so a
+     * result is only ever returned for the unchanged document it was
+     * computed on; outdated entries are replaced on the next miss or evicted
+     * as least recently used.
+     *
+     * The capacity bounds the stored nodes, not the number of results: each
+     * result counts its nodes plus one, and results larger than the
+     * capacity are not kept. Safe to use from several threads; results are
+     * shared immutable vectors, so a lookup holds the lock only for the hash
+     * probe and never copies a result.
+     *
+     * With an account, the entries are charged in `MemoryAccount::DOCUMENT`
+     * and a result that does not fit in the budget is not kept.
+     */
+    class QueryCache
+    {
+    public:
+        typedef std::shared_ptr<const std::vector<Node*>> Result;
+
+        static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+
+        explicit QueryCache(size_t capacity = DEFAULT_CAPACITY, MemoryAccount* memory = nullptr);
+        ~QueryCache();
+
+        /** Get the cached result, or null */
+        Result find(const Node* root, const std::string& selector, uint64_t generation);
+        void store(const Node* root, const std::string& selector, uint64_t generation, Result nodes);
+
+        size_t capacity() const;
+        void capacity(size_t capacity); /** Set the number of result nodes kept, 0 disables the cache */
+        size_t size() const; /** Get the number of results kept */
+        size_t nodes() const; /** Get the number of result nodes kept, as counted against the capacity */
+        size_t hits() const;
+        size_t misses() const;
+        void clear(); /** Drop all results and reset the counters */
+
+    private:
+        struct Key
+        {
+            const Node* root;
+            std::string selector;
+
+            bool operator==(const Key& other) const { return root == other.root && selector == other.selector; }
+        };
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const
+            {
+                return std::hash<const Node*>()(key.root) * 31 + std::hash<std::string>()(key.selector);
+            }
+        };
+        struct Entry
+        {
+            Key key;
+            uint64_t generation;
+            Result nodes;
+        };
+
+        static size_t cost(const Result& nodes); /** Get the count of `nodes` against the capacity */
+        static size_t bytes(const Entry& entry); /** Get the bytes charged for `entry` */
+        void erase(std::list<Entry>::iterator it); /** Drop `it` and release what it counts */
+        void evict(); /** Drop the least recently used entries above capacity */
+
+        mutable std::mutex mutex_;
+        MemoryAccount* memory_;
+        size_t capacity_;
+        size_t nodes_ = 0;
+        std::list<Entry> entries_; // most recently used first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+        std::atomic<size_t> hits_{0};
+        std::atomic<size_t> misses_{0};
+    };
+}
+
+#endif // _QUERY_CACHE_H
@@ -0,0 +1,78 @@
+#include <regex>
+#include "selector.h"
+#include "html_node.h"
+
+namespace SeeQuery
+{
+    Selector::Selector(const std::string& query)
+    {
+        // Compiled once: building a regex is costly and copies the global locale,
+        // which serializes threads. Matching against a const regex is thread-safe.
+        static const std::regex re_single_tag(R"(^<([\w-]+)\s*\/?>(?:<\/\1>|)$)");
+        static const std::regex re_quick_expr(R"(^(?:#([\w-]+)|(\w+)|\.([\w-]+))$)");
+
+        std::smatch match;
+        if (std::regex_match(query, match, re_single_tag)) {
+            type_ = CREATE;
+            value_ = match[1];
+        } else if (std::regex_match(query, match, re_quick_expr)) {
+            if (match[1].matched) {
+                type_ = ID;
+                value_ = match[1];
+            } else if (match[2].matched) {
+                type_ = TAG;
+                value_ = match[2];
+            } else {
+                type_ = CLASS;
+                value_ = match[3];
+            }
+        }
+    }
+    Selector::Type Selector::type() const
+    {
+        return type_;
+    }
+    const std::string& Selector::value() const
+    {
+        return value_;
+    }
+    bool Selector::matches(const Node& node) const
+    {
+        if (node.nodeType() != Node::ELEMENT_NODE) {
+            return false;
+        }
+        auto& element = static_cast<const HtmlNode&>(node);
+        switch (type_) {
+        case ID:
+            return element.attrValue("id") == value_;
+        case TAG:
+            return element.tagName() == value_;
+        case CLASS:
+            return element.hasClass(value_);
+        default:
+            return false;
+        }
+    }
+    void Selector::select(Node* root, std::vector<Node*>& out) const
+    {
+        switch (type_) {
+        case ID:
+            if (Node* node = root->getElementById(value_)) {
+                out.push_back(node);
+            }
+            break;
+        case TAG:
+            for (Node* node: root->getElementsByTagName(value_)) {
+                out.push_back(node);
+            }
+            break;
+        case CLASS:
+            for (Node* node: root->getElementsByClassName(value_)) {
+                out.push_back(node);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef _SELECTOR_H
+#define _SELECTOR_H
+
+#include <string>
+#include <vector>
+#include "node.h"
+
+namespace SeeQuery
+{
+    /**
+     * Parsed `Collection::operator()` query: an element to create ('<tag/>')
+     * or a quick expression ('#id', 'tag', '.class').
+     */
+    class Selector
+    {
+    public:
+        enum Type {
+            INVALID, // not a supported query
+            CREATE, // '<tag/>' or '<tag></tag>'
+            ID, // '#id'
+            TAG, // 'tag'
+            CLASS // '.class'
+        };
+
+        explicit Selector(const std::string& query);
+
+        Type type() const;
+        const std::string& value() const; /** Get the tag name, id or class name */
+
+        bool matches(const Node& node) const; /** Return true if `node` itself matches */
+        void select(Node* root, std::vector<Node*>& out) const; /** Append matches within the subtree of `root` */
+    private:
+        Type type_ = INVALID;
+        std::string value_;
+    };
+}
+
+#endif // _SELECTOR_H
@@ -0,0 +1,335 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.h"
+#include "html_node.h"
+#include "text_node.h"
+#include "document.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        /*
+         * Layout, all integers little-endian:
+         *
+         *     header      magic "SQSN", version, string count, node count,
+         *                 attribute count (u32 each), character count (u64)
+         *     strings     u32 offsets[string count + 1] into the characters
+         *     nodes       {u32 name, u32 subtree size, u32 attribute count}
+         *     attributes  {u32 key, u32 type, u64 value}, in node order
+         *     characters
+         *
+         * The name of a text node is its text with `TEXT_FLAG` set. The value
+         * of a string attribute is a string id, the others hold the number.
+         */
+        const char MAGIC[4] = {'S', 'Q', 'S', 'N'};
+        const size_t HEADER_SIZE = 28;
+        const size_t NODE_SIZE = 12;
+        const size_t ATTRIBUTE_SIZE = 16;
+        const uint32_t TEXT_FLAG = 0x80000000;
+
+        void put32(std::string& out, uint32_t value)
+        {
+            char bytes[4];
+            for (int i = 0; i < 4; ++i) {
+                bytes[i] = static_cast<char>(value >> (8 * i));
+            }
+            out.append(bytes, 4);
+        }
+        void put64(std::string& out, uint64_t value)
+        {
+            put32(out, static_cast<uint32_t>(value));
+            put32(out, static_cast<uint32_t>(value >> 32));
+        }
+        uint32_t get32(const char* data)
+        {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+            return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+        }
+        uint64_t get64(const char* data)
+        {
+            return uint64_t(get32(data)) | uint64_t(get32(data + 4)) << 32;
+        }
+        void check(bool condition, const char* what)
+        {
+            if (!condition) {
+                throw std::runtime_error(std::string("Snapshot: ") + what);
+            }
+        }
+        /* Counts must stay below `TEXT_FLAG` so that string ids can carry it: */
+        void check_count(size_t count, const char* what)
+        {
+            if (count >= TEXT_FLAG) {
+                throw std::length_error(std::string("Snapshot: too many ") + what);
+            }
+        }
+
+        /** Distinct strings of a snapshot being saved */
+        class StringTable
+        {
+        public:
+            uint32_t id(const std::string& s)
+            {
+                auto it = ids_.find(s);
+                if (it != ids_.end()) {
+                    return it->second;
+                }
+                check_count(ids_.size(), "strings");
+                if (s.size() > UINT32_MAX - chars_.size()) {
+                    throw std::length_error("Snapshot: more than 4 GiB of characters");
+                }
+                uint32_t id = static_cast<uint32_t>(ids_.size());
+                ids_.insert(std::make_pair(s, id));
+                offsets_.push_back(static_cast<uint32_t>(chars_.size()));
+                chars_ += s;
+                return id;
+            }
+            size_t size() const { return ids_.size(); }
+            const std::string& chars() const { return chars_; }
+            void writeOffsets(std::string& out) const
+            {
+                for (uint32_t offset: offsets_) {
+                    put32(out, offset);
+                }
+                put32(out, static_cast<uint32_t>(chars_.size()));
+            }
+        private:
+            std::unordered_map<std::string, uint32_t> ids_;
+            std::vector<uint32_t> offsets_;
+            std::string chars_;
+        };
+    }
+
+    constexpr uint32_t Snapshot::VERSION;
+
+    void Snapshot::save(const Node& root, Writer& out)
+    {
+        // Nodes in document order, with the subtree sizes filled in once
+        // their subtrees are complete:
+        std::vector<const Node*> nodes(1, &root);
+        for (Node& node: root.descendants()) {
+            nodes.push_back(&node);
+        }
+        check_count(nodes.size(), "nodes");
+        std::vector<uint32_t> sizes(nodes.size(), 1);
+        std::vector<size_t> open; // ancestors of the current node
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            while (!open.empty() && nodes[open.back()] != nodes[i]->parent()) {
+                size_t closed = open.back();
+                open.pop_back();
+                if (!open.empty()) {
+                    sizes[open.back()] += sizes[closed];
+                }
+            }
+            open.push_back(i);
+        }
+        while (open.size() > 1) {
+            size_t closed = open.back();
+            open.pop_back();
+            sizes[open.back()] += sizes[closed];
+        }
+
+        StringTable strings;
+        std::string records;
+        std::string attributes;
+        size_t attribute_count = 0;
+        records.reserve(nodes.size() * NODE_SIZE);
+        std::string text;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const Node& node = *nodes[i];
+            if (node.nodeType() == Node::TEXT_NODE) {
+                text.clear();
+                static_cast<const TextNode&>(node).appendTo(text);
+                put32(records, strings.id(text) | TEXT_FLAG);
+                put32(records, sizes[i]);
+                put32(records, 0);
+                continue;
+            }
+            const HtmlNode& element = static_cast<const HtmlNode&>(node);
+            put32(records, strings.id(element.tagName()));
+            put32(records, sizes[i]);
+            put32(records, static_cast<uint32_t>(element.attributes().size()));
+            for (auto& attr: element.attributes()) {
+                put32(attributes, strings.id(attr.first));
+                const AttributeValue& value = attr.second;
+                put32(attributes, value.type());
+                switch (value.type()) {
+                case AttributeValue::STRING:
+                    put64(attributes, strings.id(value.str()));
+                    break;
+                case AttributeValue::INTEGER:
+                    put64(attributes, static_cast<uint64_t>(value.toInteger()));
+                    break;
+                case AttributeValue::REAL: {
+                    double real = value.toReal();
+                    uint64_t bits;
+                    std::memcpy(&bits, &real, sizeof(bits));
+                    put64(attributes, bits);
+                    break;
+                }
+                }
+                ++attribute_count;
+            }
+            check_count(attribute_count, "attributes");
+        }
+
+        std::string header(MAGIC, sizeof(MAGIC));
+        put32(header, VERSION);
+        put32(header, static_cast<uint32_t>(strings.size()));
+        put32(header, static_cast<uint32_t>(nodes.size()));
+        put32(header, static_cast<uint32_t>(attribute_count));
+        put64(header, strings.chars().size());
+        strings.writeOffsets(header);
+        out.write(header);
+        out.write(records);
+        out.write(attributes);
+        out.write(strings.chars());
+    }
+    std::string Snapshot::save(const Node& root)
+    {
+        StringWriter out;
+        save(root, out);
+        return std::move(out.str());
+    }
+    Node* Snapshot::load(const char* data, size_t size, std::shared_ptr<Document> document)
+    {
+        check(size >= HEADER_SIZE && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0, "not a snapshot");
+        check(get32(data + 4) == VERSION, "unsupported version");
+        uint64_t string_count = get32(data + 8);
+        uint64_t node_count = get32(data + 12);
+        uint64_t attribute_count = get32(data + 16);
+        uint64_t char_count = get64(data + 20);
+        uint64_t records_at = HEADER_SIZE + (string_count + 1) * 4;
+        uint64_t attributes_at = records_at + node_count * NODE_SIZE;
+        uint64_t chars_at = attributes_at + attribute_count * ATTRIBUTE_SIZE;
+        check(node_count > 0 && char_count <= size && chars_at == size - char_count, "truncated");
+        const char* offsets = data + HEADER_SIZE;
+        const char* records = data + records_at;
+        const char* attributes = data + attributes_at;
+        const char* chars = data + chars_at;
+
+        // The strings, shared by all the nodes using them:
+        std::vector<std::shared_ptr<const std::string>> strings(string_count);
+        for (size_t i = 0; i < string_count; ++i) {
+            uint32_t begin = get32(offsets + i * 4);
+            uint32_t end = get32(offsets + i * 4 + 4);
+            check(begin <= end && end <= char_count, "bad string offset");
+            std::string s(chars + begin, end - begin);
+            strings[i] = document ? document->intern(s) : std::make_shared<const std::string>(std::move(s));
+        }
+        auto string = [&](uint64_t id) -> const std::shared_ptr<const std::string>& {
+            check(id < string_count, "bad string id");
+            return strings[id];
+        };
+
+        // Nodes come in document order; the open elements are those whose
+        // subtree extends past the current node:
+        struct Open
+        {
+            Node* node;
+            uint64_t end;
+        };
+        std::vector<Open> open;
+        Node* root = nullptr;
+        size_t attribute = 0;
+        try {
+            for (uint64_t i = 0; i < node_count; ++i) {
+                const char* record = records + i * NODE_SIZE;
+                uint32_t name = get32(record);
+                uint64_t end = i + get32(record + 4);
+                uint32_t count = get32(record + 8);
+                while (!open.empty() && open.back().end <= i) {
+                    open.pop_back();
+                }
+                check(end > i && end <= node_count && (open.empty() ? i == 0 : end <= open.back().end),
+                    "bad subtree size");
+                if (name & TEXT_FLAG) {
+                    check(count == 0 && end == i + 1, "text node with attributes or children");
+                }
+                Node* node = name & TEXT_FLAG
+                    ? static_cast<Node*>(new TextNode(string(name & ~TEXT_FLAG), document))
+                    : new HtmlNode(*string(name), {}, document);
+                // Attached at once, so that it is deleted with the tree on errors:
+                if (!root) {
+                    root = node;
+                } else {
+                    open.back().node->append(node);
+                }
+                if (name & TEXT_FLAG) {
+                    continue;
+                }
+                check(attribute + count <= attribute_count, "bad attribute count");
+                for (; count; --count, ++attribute) {
+                    const char* entry = attributes + attribute * ATTRIBUTE_SIZE;
+                    uint64_t value = get64(entry + 8);
+                    const std::string& key = *string(get32(entry));
+                    switch (get32(entry + 4)) {
+                    case AttributeValue::STRING:
+                        node->attr(key, AttributeValue(string(value)));
+                        break;
+                    case AttributeValue::INTEGER:
+                        node->attr(key, AttributeValue(static_cast<int64_t>(value)));
+                        break;
+                    case AttributeValue::REAL: {
+                        double real;
+                        std::memcpy(&real, &value, sizeof(real));
+                        node->attr(key, AttributeValue(real));
+                        break;
+                    }
+                    default:
+                        check(false, "bad attribute type");
+                    }
+                }
+                open.push_back({node, end});
+            }
+            check(attribute == attribute_count, "bad attribute count");
+        } catch (...) {
+            delete root;
+            throw;
+        }
+        return root;
+    }
+    Node* Snapshot::load(const std::string& data, std::shared_ptr<Document> document)
+    {
+        return load(data.data(), data.size(), std::move(document));
+    }
+    Node* Snapshot::loadFile(const std::string& path, std::shared_ptr<Document> document)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "open");
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "fstat");
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        void* data = size ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        int error = errno;
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            if (size == 0) {
+                return load(nullptr, 0, std::move(document)); // throws
+            }
+            throw std::system_error(error, std::generic_category(), "mmap");
+        }
+        try {
+            Node* root = load(static_cast<const char*>(data), size, std::move(document));
+            ::munmap(data, size);
+            return root;
+        } catch (...) {
+            ::munmap(data, size);
+            throw;
+        }
+    }
+}
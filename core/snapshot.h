@@ -0,0 +1,45 @@
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include "node.h"
+#include "writer.h"
+
+namespace SeeQuery
+{
+    /**
+     * Versioned binary snapshot of a node tree, to save documents and load
+     * them back without rebuilding or parsing them.
+     *
+     * A snapshot holds one table of distinct strings (tag names, attribute
+     * keys and values, text) and the nodes in document order, each with its
+     * subtree size and its attributes as (key, value) string ids; numeric
+     * attributes keep their binary form. Loading is a single pass over the
+     * nodes, from a buffer or from a memory-mapped file, and equal strings
+     * are shared by the loaded nodes.
+     *
+     * The root is restored as a plain element: a `Dom` loses its doctype.
+     * Malformed or unsupported snapshots raise `std::runtime_error`. Ids
+     * and counts are 32-bit, so saving a tree with 2^31 or more nodes,
+     * attributes or distinct strings, or more than 4 GiB of distinct
+     * characters, raises `std::length_error`.
+     */
+    class Snapshot
+    {
+    public:
+        static constexpr uint32_t VERSION = 1;
+
+        static void save(const Node& root, Writer& out); /** Write a snapshot of `root` and its subtree */
+        static std::string save(const Node& root);
+
+        /** Build the tree of a snapshot in `document` (if any); the caller owns the result */
+        static Node* load(const char* data, size_t size, std::shared_ptr<Document> document = nullptr);
+        static Node* load(const std::string& data, std::shared_ptr<Document> document = nullptr);
+        /** Load the snapshot saved in file `path`, mapping it into memory */
+        static Node* loadFile(const std::string& path, std::shared_ptr<Document> document = nullptr);
+    };
+}
+
+#endif // _SNAPSHOT_H
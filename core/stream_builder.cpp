@@ -0,0 +1,125 @@
+#include <stdexcept>
+#include <unordered_map>
+#include "stream_builder.h"
+#include "selector.h"
+
+namespace SeeQuery
+{
+    StreamBuilder::Scope::Scope(StreamBuilder* builder, uint64_t serial) :
+        builder_(builder),
+        serial_(serial)
+    {}
+    StreamBuilder::Scope::Scope(Scope&& other) :
+        builder_(other.builder_),
+        serial_(other.serial_)
+    {
+        other.builder_ = nullptr;
+    }
+    StreamBuilder::Scope::~Scope()
+    {
+        close();
+    }
+    void StreamBuilder::Scope::close()
+    {
+        if (builder_) {
+            builder_->close(serial_);
+            builder_ = nullptr;
+        }
+    }
+
+    StreamBuilder::StreamBuilder(Writer& out) :
+        out_(out)
+    {}
+    StreamBuilder::~StreamBuilder()
+    {
+        finish();
+    }
+    StreamBuilder::Scope StreamBuilder::operator()(const std::string& element,
+        std::initializer_list<Attribute> attributes)
+    {
+        Selector selector(element);
+        if (selector.type() != Selector::CREATE) {
+            throw std::invalid_argument("StreamBuilder: expected '<tag/>', got '" + element + "'");
+        }
+        child();
+        // Attributes are collected in the same container as `HtmlNode` uses,
+        // so they come out in the same order:
+        std::unordered_map<std::string, AttributeValue> collected;
+        for (auto& attr: attributes) {
+            if (attr.key != "text") {
+                collected.insert(std::make_pair(attr.key, attr.value));
+            }
+        }
+        out_.indent(open_.size());
+        out_.writeRef("<", 1);
+        out_.write(selector.value());
+        for (auto& attr: collected) {
+            out_.writeRef(" ", 1);
+            out_.write(attr.first);
+            out_.writeRef("=\"", 2);
+            scratch_.clear();
+            attr.second.appendTo(scratch_);
+            out_.write(scratch_);
+            out_.writeRef("\"", 1);
+        }
+        open_.push_back({selector.value(), false, ++serial_});
+        for (auto& attr: attributes) {
+            if (attr.key == "text") {
+                text(attr.value.str());
+            }
+        }
+        return Scope(this, serial_);
+    }
+    void StreamBuilder::text(const std::string& text)
+    {
+        child();
+        out_.indent(open_.size());
+        out_.write(text);
+        out_.writeRef("\n", 1);
+    }
+    void StreamBuilder::doctype()
+    {
+        out_.writeRef("<!DOCTYPE html>\n", 16);
+    }
+    void StreamBuilder::finish()
+    {
+        closeTo(1);
+    }
+    size_t StreamBuilder::depth() const
+    {
+        return open_.size();
+    }
+    void StreamBuilder::child()
+    {
+        if (!open_.empty() && !open_.back().has_children) {
+            out_.writeRef(">\n", 2);
+            open_.back().has_children = true;
+        }
+    }
+    void StreamBuilder::close(uint64_t serial)
+    {
+        // Closed already by an enclosing scope, the element may have been
+        // replaced by a later one at the same depth:
+        for (size_t i = open_.size(); i > 0; --i) {
+            if (open_[i - 1].serial == serial) {
+                closeTo(i);
+                return;
+            }
+        }
+    }
+    void StreamBuilder::closeTo(size_t depth)
+    {
+        while (open_.size() >= depth && !open_.empty()) {
+            Open& element = open_.back();
+            if (element.has_children) {
+                out_.indent(open_.size() - 1);
+                out_.writeRef("</", 2);
+                out_.write(element.tag);
+                out_.writeRef(">\n", 2);
+            } else {
+                out_.writeRef("/>\n", 3);
+            }
+            open_.pop_back();
+        }
+    }
+}
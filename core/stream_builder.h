@@ -0,0 +1,86 @@
+#ifndef _STREAM_BUILDER_H
+#define _STREAM_BUILDER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "html_node.h"
+#include "writer.h"
+
+namespace SeeQuery
+{
+    /**
+     * Forward-only document builder writing markup straight to a `Writer`.
+     *
+     * Elements are opened with the familiar syntax and closed when the
+     * returned scope ends, so nesting follows the C++ scopes:
+     *
+     *     StreamBuilder $(out);
+     *     auto svg = $("<svg/>", {{"width", 800}});
+     *     for (...) {
+     *         $("<rect/>", {{"x", x}, {"y", y}}); // closed at the end of the statement
+     *     }
+     *
+     * No nodes are kept: memory is bounded by the nesting depth, not by the
+     * document size. The output is byte-identical to serializing the same
+     * tree built with `SeeQuery` (top-level elements are followed by a
+     * newline, as in `Collection::serialize()`).
+     */
+    class StreamBuilder
+    {
+    public:
+        /** Open element; closes it (and any element still open inside) when destroyed */
+        class Scope
+        {
+        public:
+            Scope(Scope&& other);
+            ~Scope();
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+            /** Close the element before the end of the scope; a no-op if it is closed already */
+            void close();
+        private:
+            friend class StreamBuilder;
+            Scope(StreamBuilder* builder, uint64_t serial);
+
+            StreamBuilder* builder_;
+            uint64_t serial_; // of the element, see `Open::serial`
+        };
+
+        explicit StreamBuilder(Writer& out);
+        ~StreamBuilder(); /** Close all open elements */
+        StreamBuilder(const StreamBuilder&) = delete;
+        StreamBuilder& operator=(const StreamBuilder&) = delete;
+
+        /**
+         * Open element '<tag/>' inside the current one. A "text" attribute
+         * adds a text node, as with `SeeQuery`. Throws
+         * `std::invalid_argument` for other selectors.
+         */
+        Scope operator()(const std::string& element, std::initializer_list<Attribute> attributes = {});
+        void text(const std::string& text); /** Add a text node to the current element */
+        void doctype(); /** Write the doctype line of `Dom` */
+        void finish(); /** Close all open elements */
+        size_t depth() const; /** Get the number of open elements */
+
+    private:
+        struct Open
+        {
+            std::string tag;
+            bool has_children;
+            uint64_t serial; // tells the element from one opened later at the same depth
+        };
+
+        void child(); /** Prepare the current element for a child */
+        void close(uint64_t serial); /** Close the element `serial` and those inside, if still open */
+        void closeTo(size_t depth); /** Close the elements nested `depth` or deeper */
+
+        Writer& out_;
+        std::vector<Open> open_;
+        uint64_t serial_ = 0; // of the last element opened
+        std::string scratch_; // formatted attribute value
+    };
+}
+
+#endif // _STREAM_BUILDER_H
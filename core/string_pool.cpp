@@ -0,0 +1,46 @@
+#include "string_pool.h"
+
+namespace SeeQuery
+{
+    StringPool::Handle StringPool::intern(const std::string& s)
+    {
+        // Look up through a non-owning handle, so a hit does not allocate:
+        Handle key(Handle(), &s);
+        auto it = strings_.find(key);
+        if (it != strings_.end()) {
+            return *it;
+        }
+        Handle handle = std::make_shared<const std::string>(s);
+        strings_.insert(handle);
+        return handle;
+    }
+    size_t StringPool::size() const
+    {
+        return strings_.size();
+    }
+    size_t StringPool::bytes() const
+    {
+        size_t result = 0;
+        for (auto& s: strings_) {
+            result += sizeof(std::string) + s->capacity();
+        }
+        return result;
+    }
+    size_t StringPool::prune()
+    {
+        size_t dropped = 0;
+        for (auto it = strings_.begin(); it != strings_.end();) {
+            if (it->use_count() == 1) {
+                it = strings_.erase(it);
+                ++dropped;
+            } else {
+                ++it;
+            }
+        }
+        return dropped;
+    }
+    void StringPool::clear()
+    {
+        strings_.clear();
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef _STRING_POOL_H
+#define _STRING_POOL_H
+
+#include <string>
+#include <memory>
+#include <unordered_set>
+
+namespace SeeQuery
+{
+    /**
+     * Deduplicated storage for immutable strings.
+     *
+     * `intern()` returns a shared handle to the single pooled copy of a
+     * string. Handles are reference counted, so pooled strings stay valid
+     * after the pool (or the document owning it) is gone; `prune()` drops the
+     * strings no longer referenced outside of the pool.
+     */
+    class StringPool
+    {
+    public:
+        typedef std::shared_ptr<const std::string> Handle;
+
+        Handle intern(const std::string& s); /** Get the pooled copy of `s`, adding it if needed */
+        size_t size() const; /** Get the number of distinct strings */
+        size_t bytes() const; /** Get the number of bytes held by pooled strings */
+        size_t prune(); /** Drop strings referenced by the pool only, return the number dropped */
+        void clear(); /** Drop all strings (handles given out stay valid) */
+
+    private:
+        struct Hash
+        {
+            size_t operator()(const Handle& h) const { return std::hash<std::string>()(*h); }
+        };
+        struct Equal
+        {
+            bool operator()(const Handle& a, const Handle& b) const { return *a == *b; }
+        };
+        std::unordered_set<Handle, Hash, Equal> strings_;
+    };
+}
+
+#endif // _STRING_POOL_H
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <stdexcept>
+#include "template.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        // Extract the slot name from "{{name}}", return false if `value` is not a slot:
+        bool slot_name(const std::string& value, std::string& name)
+        {
+            if (value.size() < 5 || value.compare(0, 2, "{{") != 0
+                    || value.compare(value.size() - 2, 2, "}}") != 0) {
+                return false;
+            }
+            name = value.substr(2, value.size() - 4);
+            return true;
+        }
+
+        // Binding for slot `name`, or null:
+        const Attribute* find_binding(std::initializer_list<Attribute> bindings, const std::string& name)
+        {
+            for (auto& binding: bindings) {
+                if (binding.key == name) {
+                    return &binding;
+                }
+            }
+            return nullptr;
+        }
+
+        // Next node in document order within the subtree of `root`:
+        Node* next_node(Node* root, Node* node)
+        {
+            if (node->firstChild()) {
+                return node->firstChild();
+            }
+            while (node != root) {
+                if (node->nextSibling()) {
+                    return node->nextSibling();
+                }
+                node = node->parent();
+            }
+            return nullptr;
+        }
+    }
+
+    Template::Template(const Collection& fragment)
+    {
+        if (fragment.size() == 0) {
+            return;
+        }
+        prototype_.reset(fragment.children_.front()->clone());
+        std::string name;
+        size_t position = 0;
+        for (Node* node = prototype_.get(); node; node = next_node(prototype_.get(), node), ++position) {
+            if (node->nodeType() == Node::TEXT_NODE) {
+                if (slot_name(node->text(), name)) {
+                    slots_.push_back(Slot{name, position, std::string()});
+                }
+                continue;
+            }
+            for (auto& attribute: static_cast<HtmlNode*>(node)->attributes()) {
+                if (!attribute.second.isNumber() && slot_name(attribute.second.str(), name)) {
+                    slots_.push_back(Slot{name, position, attribute.first});
+                }
+            }
+        }
+    }
+    Collection Template::operator()(std::initializer_list<Attribute> bindings) const
+    {
+        for (auto& binding: bindings) {
+            auto is_bound = [&binding](const Slot& slot) { return slot.name == binding.key; };
+            if (std::none_of(slots_.begin(), slots_.end(), is_bound)) {
+                throw std::invalid_argument("Template: no slot named \"" + binding.key + "\"");
+            }
+        }
+        Collection result;
+        if (!prototype_) {
+            return result;
+        }
+        std::unique_ptr<Node> instance(prototype_->clone());
+        // Slots come in document order, so one walk of the copy reaches them all:
+        Node* node = instance.get();
+        size_t position = 0;
+        for (auto& slot: slots_) {
+            for (; position < slot.node; ++position) {
+                node = next_node(instance.get(), node);
+            }
+            const Attribute* binding = find_binding(bindings, slot.name);
+            if (slot.key.empty()) {
+                static_cast<TextNode*>(node)->text(binding ? binding->value.str() : std::string());
+            } else if (binding) {
+                node->attr(slot.key, binding->value);
+            } else {
+                static_cast<HtmlNode*>(node)->removeAttr(slot.key);
+            }
+        }
+        result.push_back(instance.release());
+        return result;
+    }
+    size_t Template::slots() const
+    {
+        return slots_.size();
+    }
+    std::string Template::slot(const std::string& name)
+    {
+        return "{{" + name + "}}";
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef _TEMPLATE_H
+#define _TEMPLATE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "collection.h"
+
+namespace SeeQuery
+{
+    /**
+     * Precompiled fragment for stamping out many similar elements.
+     *
+     * The fragment is built once with the usual syntax; attribute values and
+     * text nodes equal to `Template::slot(name)` mark the places to fill in:
+     *
+     *     Template rect($("<rect/>", {
+     *         {"x", Template::slot("x")},
+     *         {"class", "bar"}
+     *     }));
+     *     svg.append(rect({{"x", 10}}));
+     *
+     * Slots are resolved when the template is compiled, so an instance is a
+     * deep copy of the prototype with the bound values written straight into
+     * the slot positions: no selector parsing and no lookups of fixed keys.
+     * Attribute slots left unbound are removed and text slots left unbound
+     * are emptied; binding a name that is not a slot throws
+     * `std::invalid_argument`.
+     */
+    class Template
+    {
+    public:
+        explicit Template(const Collection& fragment); /** Compile the first element of `fragment` */
+        Template(const Template&) = delete;
+        Template& operator=(const Template&) = delete;
+
+        Collection operator()(std::initializer_list<Attribute> bindings = {}) const; /** Instantiate */
+
+        size_t slots() const; /** Get the number of slot positions */
+        static std::string slot(const std::string& name); /** Get the placeholder for slot `name` */
+
+    private:
+        struct Slot
+        {
+            std::string name;
+            size_t node; // position of the node in document order
+            std::string key; // attribute key, empty for a text slot
+        };
+
+        std::unique_ptr<Node> prototype_;
+        std::vector<Slot> slots_; // in document order
+    };
+}
+
+#endif // _TEMPLATE_H
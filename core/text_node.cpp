@@ -1,18 +1,138 @@
 #include <string>
+#include <memory>
 #include "text_node.h"
+#include "document.h"
+#include "writer.h"
+#include "journal.h"
 
 namespace SeeQuery
 {
-    TextNode::TextNode(const std::string& text) :
-        text_(text)
-    {}
-    std::string TextNode::serialize(size_t depth /*= 0*/) const
+    constexpr size_t TextNode::SMALL_CHUNK;
+
+    TextNode::TextNode(const std::string& text, std::shared_ptr<Document> document) :
+        text_(document
+            ? document->internText(text)
+            : std::make_shared<const std::string>(text))
+    {
+        document_ = std::move(document);
+        charge();
+    }
+    TextNode::TextNode(std::shared_ptr<const std::string> text, std::shared_ptr<Document> document) :
+        text_(std::move(text))
+    {
+        document_ = std::move(document);
+        charge();
+    }
+    TextNode::~TextNode()
+    {
+        release();
+    }
+    void TextNode::serialize(Writer& out, size_t depth /*= 0*/) const
     {
-        return std::string(depth * INDENT_WIDTH, ' ') + text_;
+        out.indent(depth);
+        out.writeRef(*text_);
+        if (more_) {
+            for (auto& chunk: more_->chunks) {
+                out.writeRef(*chunk);
+            }
+        }
     }
     std::string TextNode::text() const
     {
-        return text_;
+        if (!more_) {
+            return *text_;
+        }
+        std::string result;
+        result.reserve(more_->length);
+        appendTo(result);
+        return result;
+    }
+    void TextNode::text(const std::string& text)
+    {
+        charge(MemoryAccount::TEXT, length(), text.size());
+        text_ = document_
+            ? document_->internText(text)
+            : std::make_shared<const std::string>(text);
+        account(MemoryAccount::NODES, ropeBytes(more_), 0);
+        more_.reset();
+        changed();
+        if (Journal* log = journal()) {
+            log->textSet(this, AttributeValue(text_));
+        }
+    }
+    void TextNode::appendText(const std::string& text)
+    {
+        if (text.empty()) {
+            return;
+        }
+        charge(MemoryAccount::TEXT, 0, text.size());
+        auto chunk = std::make_shared<const std::string>(text);
+        appendChunk(chunk);
+        appended(chunk);
+    }
+    void TextNode::appendText(const TextNode& other)
+    {
+        // Copy the list first: `other` may be this node.
+        charge(MemoryAccount::TEXT, 0, other.length());
+        std::vector<std::shared_ptr<const std::string>> chunks(1, other.text_);
+        if (other.more_) {
+            chunks.insert(chunks.end(), other.more_->chunks.begin(), other.more_->chunks.end());
+        }
+        for (auto& chunk: chunks) {
+            if (!chunk->empty()) {
+                appendChunk(chunk);
+                appended(chunk);
+            }
+        }
+    }
+    size_t TextNode::length() const
+    {
+        return more_ ? more_->length : text_->size();
+    }
+    void TextNode::appendTo(std::string& out) const
+    {
+        out += *text_;
+        if (more_) {
+            for (auto& chunk: more_->chunks) {
+                out += *chunk;
+            }
+        }
+    }
+    size_t TextNode::chunks() const
+    {
+        return more_ ? 1 + more_->chunks.size() : 1;
+    }
+    void TextNode::appendChunk(std::shared_ptr<const std::string> chunk)
+    {
+        size_t length = this->length() + chunk->size();
+        size_t rope_bytes = ropeBytes(more_);
+        auto& last = more_ ? more_->chunks.back() : text_;
+        if (last->empty()) {
+            last = std::move(chunk);
+        } else if (last->size() + chunk->size() <= SMALL_CHUNK) {
+            // Copying a few bytes is cheaper than another chunk:
+            last = std::make_shared<const std::string>(*last + *chunk);
+        } else {
+            if (!more_) {
+                more_.reset(new Rope());
+            }
+            more_->chunks.push_back(std::move(chunk));
+        }
+        if (more_) {
+            more_->length = length;
+        }
+        account(MemoryAccount::NODES, rope_bytes, ropeBytes(more_));
+    }
+    void TextNode::appended(const std::shared_ptr<const std::string>& chunk)
+    {
+        changed();
+        if (Journal* log = journal()) {
+            log->textAppended(this, AttributeValue(chunk));
+        }
+    }
+    size_t TextNode::ropeBytes(const std::unique_ptr<Rope>& rope)
+    {
+        return rope ? sizeof(Rope) + rope->chunks.capacity() * sizeof(rope->chunks[0]) : 0;
     }
     std::string TextNode::html() const
     {
@@ -24,6 +144,12 @@ namespace SeeQuery
     }
     void TextNode::attr(const std::string&, const std::string&)
     { /* Do nothing. TextNode ignores setting attribute */ }
+    AttributeValue TextNode::attrValue(const std::string&) const
+    {
+        return AttributeValue();
+    }
+    void TextNode::attr(const std::string&, const AttributeValue&)
+    { /* Do nothing. TextNode ignores setting attribute */ }
     Node* TextNode::getElementById(const std::string&)
     {
         return nullptr;
@@ -36,9 +162,26 @@ namespace SeeQuery
     {
         return std::list<Node*>();
     }
+    int TextNode::nodeType() const
+    {
+        return TEXT_NODE;
+    }
     Node* TextNode::clone() const
     {
-        return new TextNode(text_);
+        // Owned until complete, so a clone failing on the memory budget is freed:
+        std::unique_ptr<TextNode> copy(new TextNode(text_, document_));
+        copy->charge(MemoryAccount::TEXT, copy->length(), length());
+        if (more_) {
+            std::unique_ptr<Rope> rope(new Rope(*more_)); // chunks are shared, not copied
+            copy->charge(MemoryAccount::NODES, 0, ropeBytes(rope));
+            copy->more_ = std::move(rope);
+        }
+        return copy.release();
+    }
+    void TextNode::memoryUsage(MemoryAccount::Usage& usage) const
+    {
+        usage[MemoryAccount::NODES] += sizeof(TextNode) + ropeBytes(more_);
+        usage[MemoryAccount::TEXT] += length();
     }
     Node* TextNode::append(Node*)
     {
@@ -2,33 +2,75 @@
 #define _TEXT_NODE_H
 
 #include <string>
+#include <memory>
+#include <vector>
 #include "node.h"
 
 namespace SeeQuery
 {
+    /**
+     * Text content of an element.
+     *
+     * The text is a rope of shared immutable chunks: appending adds a chunk
+     * instead of copying the text so far (tiny appends are merged into a
+     * small last chunk), clones and merged nodes share the chunks, and the
+     * serializer writes the chunks one by one. Further chunks live behind a
+     * single pointer, so a node holding one chunk (never appended to, or
+     * only by small appends) costs a null pointer and allocates nothing more.
+     */
     class TextNode: public Node
     {
     public:
-        TextNode(const std::string& text);
+        /* Appends to a last chunk shorter than this are merged into it: */
+        static constexpr size_t SMALL_CHUNK = 256;
+
+        TextNode(const std::string& text, std::shared_ptr<Document> document = nullptr);
+        ~TextNode();
 
         Node* getElementById(const std::string&);
         std::list<Node*> getElementsByTagName(const std::string&);
         std::list<Node*> getElementsByClassName(const std::string&);
 
+        int nodeType() const;
         Node* clone() const;
+        void memoryUsage(MemoryAccount::Usage& usage) const;
 
-        std::string serialize(size_t depth = 0) const;
+        using Node::serialize;
+        void serialize(Writer& out, size_t depth = 0) const;
         std::string text() const;
+        void text(const std::string& text); /** Replace text content of the node */
+        void appendText(const std::string& text); /** Append to the text content */
+        void appendText(const TextNode& other); /** Append the text of `other`, sharing its chunks */
+        size_t length() const; /** Get the length of the text in bytes */
+        void appendTo(std::string& out) const; /** Append the text to `out` */
+        size_t chunks() const; /** Get the number of chunks of the text */
         std::string html() const;
 
         std::string attr(const std::string&) const;
         void attr(const std::string&, const std::string&);
+        AttributeValue attrValue(const std::string&) const;
+        void attr(const std::string&, const AttributeValue&);
 
         Node* append(Node*);
         Node* prepend(Node*);
 
     private:
-        std::string text_;
+        friend class Snapshot;
+        TextNode(std::shared_ptr<const std::string> text, std::shared_ptr<Document> document);
+        void appendChunk(std::shared_ptr<const std::string> chunk);
+        void appended(const std::shared_ptr<const std::string>& chunk); /** Record an append in the journal */
+
+        /* Chunks after the first one: */
+        struct Rope
+        {
+            std::vector<std::shared_ptr<const std::string>> chunks;
+            size_t length; // of all the chunks, the first one included
+        };
+
+        std::shared_ptr<const std::string> text_; // first chunk, shared with clones, pooled if short
+        std::unique_ptr<Rope> more_; // null until a second chunk is added
+
+        static size_t ropeBytes(const std::unique_ptr<Rope>& rope); /** Get the bytes of a chunk list, see `MemoryAccount` */
     };
 }
 
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <exception>
+#include "thread_pool.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        // The pool and deque index of the current worker thread:
+        thread_local ThreadPool* current_pool = nullptr;
+        thread_local size_t current_index = 0;
+    }
+
+    ThreadPool::ThreadPool(size_t threads)
+    {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            queues_.emplace_back(new Queue);
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            threads_.emplace_back(&ThreadPool::worker, this, i);
+        }
+    }
+    ThreadPool::~ThreadPool()
+    {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread: threads_) {
+            thread.join();
+        }
+    }
+    size_t ThreadPool::size() const
+    {
+        return threads_.size();
+    }
+    void ThreadPool::submit(Task task)
+    {
+        size_t index = current_pool == this
+            ? current_index
+            : next_queue_++ % queues_.size();
+        ++pending_;
+        {
+            // Counted under the queue lock, so a thief never takes it first
+            // and wraps the count around:
+            std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+            queues_[index]->tasks.push_back(std::move(task));
+            ++queued_;
+        }
+        {
+            // Taking the lock orders the notification after a sleeper's check:
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        wake_.notify_one();
+    }
+    void ThreadPool::wait()
+    {
+        Task task;
+        if (current_pool == this) {
+            // A worker must not block on the task it runs; it helps instead:
+            while (take(current_index, task)) {
+                run(task);
+            }
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return pending_ == 0; });
+    }
+    void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& body)
+    {
+        std::atomic<size_t> remaining(n);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        for (size_t i = 0; i < n; ++i) {
+            submit([&, i]() {
+                try {
+                    body(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                if (--remaining == 0) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    done_.notify_all();
+                }
+            });
+        }
+        // Help with the work instead of just waiting:
+        size_t index = current_pool == this ? current_index : 0;
+        Task task;
+        while (remaining > 0) {
+            if (take(index, task)) {
+                run(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [&]() { return remaining == 0 || queued_ > 0; });
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    bool ThreadPool::take(size_t index, Task& task)
+    {
+        {
+            Queue& own = *queues_[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                --queued_;
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues_.size(); ++k) {
+            Queue& victim = *queues_[(index + k) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                --queued_;
+                return true;
+            }
+        }
+        return false;
+    }
+    void ThreadPool::run(Task& task)
+    {
+        task();
+        task = nullptr;
+        if (--pending_ == 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.notify_all();
+        }
+    }
+    void ThreadPool::worker(size_t index)
+    {
+        current_pool = this;
+        current_index = index;
+        Task task;
+        while (true) {
+            if (take(index, task)) {
+                run(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+            if (stop_ && queued_ == 0) {
+                return;
+            }
+        }
+    }
+}
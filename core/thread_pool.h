@@ -0,0 +1,69 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SeeQuery
+{
+    /**
+     * Work-stealing thread pool.
+     *
+     * Every worker has its own task deque: it takes tasks from the back of
+     * its deque and, when that is empty, steals from the front of the other
+     * workers' deques. Tasks submitted from a worker go to that worker's
+     * deque, tasks submitted from outside are spread round-robin.
+     */
+    class ThreadPool
+    {
+    public:
+        typedef std::function<void()> Task;
+
+        explicit ThreadPool(size_t threads = 0); /** Start `threads` workers, one per core if 0 */
+        ~ThreadPool(); /** Run the remaining tasks and join the workers */
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t size() const; /** Get the number of workers */
+
+        void submit(Task task); /** Schedule `task` */
+        void wait(); /** Block until all submitted tasks have finished */
+
+        /**
+         * Run `body(0)` ... `body(n - 1)` on the pool and return when all have
+         * finished. The calling thread takes part in the work, so this can be
+         * called from within a task. The first exception thrown by `body` is
+         * rethrown.
+         */
+        void parallelFor(size_t n, const std::function<void(size_t)>& body);
+
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        bool take(size_t index, Task& task); /** Pop own task or steal one */
+        void run(Task& task);
+        void worker(size_t index);
+
+        std::vector<std::unique_ptr<Queue>> queues_;
+        std::vector<std::thread> threads_;
+        std::mutex mutex_; // guards sleeping and waking up
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        std::atomic<size_t> queued_{0}; // tasks in the deques
+        std::atomic<size_t> pending_{0}; // tasks submitted and not finished
+        std::atomic<size_t> next_queue_{0};
+        bool stop_ = false;
+    };
+}
+
+#endif // _THREAD_POOL_H
@@ -0,0 +1,155 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <sstream>
+#include <cstdio>
+#include "trace.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        struct Event
+        {
+            const char* name;
+            std::string selector;
+            bool has_size;
+            size_t size;
+            uint64_t begin; // ns since the trace epoch
+            uint64_t duration; // ns
+            unsigned thread;
+        };
+
+        std::atomic<bool> tracing(false);
+        std::mutex events_mutex;
+        std::vector<Event> events;
+
+        const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+        uint64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - epoch).count();
+        }
+
+        unsigned thread_id()
+        {
+            static std::atomic<unsigned> next_id(1);
+            thread_local unsigned id = next_id++;
+            return id;
+        }
+
+        void write_json_string(std::ostream& out, const std::string& s)
+        {
+            out << '"';
+            for (char c: s) {
+                switch (c) {
+                case '"': out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\t': out << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char buf[8];
+                        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                        out << buf;
+                    } else {
+                        out << c;
+                    }
+                }
+            }
+            out << '"';
+        }
+
+        // Trace-event timestamps are in microseconds:
+        void write_us(std::ostream& out, uint64_t ns)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%llu.%03u",
+                static_cast<unsigned long long>(ns / 1000),
+                static_cast<unsigned>(ns % 1000));
+            out << buf;
+        }
+    }
+
+    void Trace::start()
+    {
+        tracing = true;
+    }
+    void Trace::stop()
+    {
+        tracing = false;
+    }
+    bool Trace::enabled()
+    {
+        return tracing.load(std::memory_order_relaxed);
+    }
+    void Trace::clear()
+    {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        events.clear();
+    }
+    size_t Trace::size()
+    {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        return events.size();
+    }
+    void Trace::dump(std::ostream& out)
+    {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        for (auto& event: events) {
+            out << (first ? "\n" : ",\n");
+            first = false;
+            out << "{\"name\":";
+            write_json_string(out, event.name);
+            out << ",\"cat\":\"seequery\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+                << ",\"ts\":";
+            write_us(out, event.begin);
+            out << ",\"dur\":";
+            write_us(out, event.duration);
+            out << ",\"args\":{";
+            if (!event.selector.empty()) {
+                out << "\"selector\":";
+                write_json_string(out, event.selector);
+            }
+            if (event.has_size) {
+                out << (event.selector.empty() ? "" : ",") << "\"size\":" << event.size;
+            }
+            out << "}}";
+        }
+        out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+    std::string Trace::json()
+    {
+        std::ostringstream oss;
+        dump(oss);
+        return oss.str();
+    }
+
+    TraceScope::TraceScope(const char* name, const std::string& selector, bool active) :
+        active_(active && Trace::enabled()),
+        name_(name)
+    {
+        if (active_) {
+            selector_ = selector;
+            begin_ = now();
+        }
+    }
+    TraceScope::~TraceScope()
+    {
+        if (!active_) {
+            return;
+        }
+        Event event{name_, std::move(selector_), has_size_, size_, begin_, now() - begin_, thread_id()};
+        std::lock_guard<std::mutex> lock(events_mutex);
+        events.push_back(std::move(event));
+    }
+    void TraceScope::size(size_t n)
+    {
+        has_size_ = true;
+        size_ = n;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+namespace SeeQuery
+{
+    /**
+     * Optional timeline of SeeQuery operations.
+     *
+     * While tracing is on, every `TraceScope` records its begin timestamp,
+     * duration, thread, selector and result size. The recorded events can be
+     * dumped as Chrome trace-event JSON and opened in chrome://tracing or
+     * https://ui.perfetto.dev. While tracing is off a scope costs a single
+     * atomic load.
+     */
+    class Trace
+    {
+    public:
+        static void start(); /** Start recording events (already recorded events are kept) */
+        static void stop(); /** Stop recording events */
+        static bool enabled(); /** Return true if events are being recorded */
+        static void clear(); /** Discard all recorded events */
+        static size_t size(); /** Get the number of recorded events */
+
+        static void dump(std::ostream& out); /** Write recorded events as Chrome trace JSON */
+        static std::string json(); /** Get recorded events as Chrome trace JSON */
+    };
+
+    class TraceScope
+    {
+    public:
+        /**
+         * Start a trace event. `name` must be a string literal, `selector` is
+         * copied only while tracing is on. Pass `active = false` to skip
+         * recording (e.g. for nested calls of a recursive traversal).
+         */
+        TraceScope(const char* name, const std::string& selector = std::string(), bool active = true);
+        ~TraceScope();
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+        void size(size_t n); /** Set the result size reported with the event */
+    private:
+        bool active_;
+        const char* name_;
+        std::string selector_;
+        bool has_size_ = false;
+        size_t size_ = 0;
+        uint64_t begin_ = 0;
+    };
+}
+
+#endif // _TRACE_H
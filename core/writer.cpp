@@ -0,0 +1,71 @@
+#include "writer.h"
+#include "node.h"
+
+namespace SeeQuery
+{
+    namespace
+    {
+        const char SPACES[] = "                                                                ";
+        constexpr size_t MAX_SPACES = sizeof(SPACES) - 1;
+    }
+
+    Writer::~Writer()
+    {}
+    void Writer::writeRef(const char* data, size_t size)
+    {
+        write(data, size);
+    }
+    void Writer::flush()
+    {}
+    void Writer::write(const std::string& s)
+    {
+        write(s.data(), s.size());
+    }
+    void Writer::writeRef(const std::string& s)
+    {
+        writeRef(s.data(), s.size());
+    }
+    void Writer::indent(size_t depth)
+    {
+        size_t n = depth * INDENT_WIDTH;
+        while (n > 0) {
+            size_t chunk = n < MAX_SPACES ? n : MAX_SPACES;
+            writeRef(SPACES, chunk);
+            n -= chunk;
+        }
+    }
+
+    void StringWriter::write(const char* data, size_t size)
+    {
+        str_.append(data, size);
+    }
+    void StringWriter::reserve(size_t size)
+    {
+        str_.reserve(size);
+    }
+    std::string& StringWriter::str()
+    {
+        return str_;
+    }
+
+    void CountingWriter::write(const char*, size_t size)
+    {
+        size_ += size;
+    }
+    size_t CountingWriter::size() const
+    {
+        return size_;
+    }
+
+    OStreamWriter::OStreamWriter(std::ostream& out) :
+        out_(out)
+    {}
+    void OStreamWriter::write(const char* data, size_t size)
+    {
+        out_.write(data, static_cast<std::streamsize>(size));
+    }
+    void OStreamWriter::flush()
+    {
+        out_.flush();
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef _WRITER_H
+#define _WRITER_H
+
+#include <string>
+#include <ostream>
+
+namespace SeeQuery
+{
+    /**
+     * Output sink of the serializer.
+     *
+     * Nodes serialize themselves piece by piece into a writer. Pieces passed
+     * to `writeRef()` (tag names, attribute keys and values, text, literal
+     * punctuation) are guaranteed to stay valid until the next `flush()`,
+     * so a writer may keep references to them instead of copying; pieces
+     * passed to `write()` (e.g. formatted numbers) must be copied.
+     */
+    class Writer
+    {
+    public:
+        virtual ~Writer();
+
+        virtual void write(const char* data, size_t size) = 0; /** Write bytes that must be copied */
+        virtual void writeRef(const char* data, size_t size); /** Write bytes valid until `flush()` */
+        virtual void flush(); /** Push written bytes to the destination */
+
+        void write(const std::string& s); /** Write a string that must be copied */
+        void writeRef(const std::string& s); /** Write a string valid until `flush()` */
+        void indent(size_t depth); /** Write the indentation for the given depth */
+    };
+
+    /** Writer collecting the output in a string */
+    class StringWriter: public Writer
+    {
+    public:
+        using Writer::write;
+        using Writer::writeRef;
+
+        void write(const char* data, size_t size);
+        void reserve(size_t size); /** Preallocate the output string */
+        std::string& str(); /** Get the output */
+    private:
+        std::string str_;
+    };
+
+    /** Writer that only counts the bytes, to size a buffer before the real pass */
+    class CountingWriter: public Writer
+    {
+    public:
+        using Writer::write;
+        using Writer::writeRef;
+
+        void write(const char* data, size_t size);
+        size_t size() const; /** Get the number of bytes written */
+    private:
+        size_t size_ = 0;
+    };
+
+    /** Writer forwarding the output to a `std::ostream` */
+    class OStreamWriter: public Writer
+    {
+    public:
+        using Writer::write;
+        using Writer::writeRef;
+
+        explicit OStreamWriter(std::ostream& out);
+        void write(const char* data, size_t size);
+        void flush();
+    private:
+        std::ostream& out_;
+    };
+}
+
+#endif // _WRITER_H
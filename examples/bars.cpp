@@ -0,0 +1,60 @@
+#include <iostream>
+#include <random>
+#include <vector>
+#include "core/collection.h"
+#include "core/html_node.h"
+
+const size_t WIDTH = 800;
+const size_t HEIGHT = 400;
+const size_t NUM_OF_TICKS = 5;
+
+struct Bar
+{
+    int id;
+    size_t value;
+};
+
+int main()
+{
+    using SeeQuery::Node;
+    using SeeQuery::SeeQuery;
+
+    // Create document:
+    SeeQuery $;
+    $("body")
+    .append($("<svg/>", {
+        {"id", "chart"},
+        {"width", WIDTH},
+        {"height", HEIGHT}
+    }));
+    auto svg = $("#chart");
+
+    std::default_random_engine re(42);
+    std::uniform_int_distribution<size_t> value_dist(10, HEIGHT);
+    std::vector<Bar> bars;
+    for (int id = 0; id < 20; ++id) {
+        bars.push_back({id, value_dist(re)});
+    }
+
+    for (size_t tick = 0; tick < NUM_OF_TICKS; ++tick) {
+        // Change a few bars, drop the first one and add a new one:
+        bars[re() % bars.size()].value = value_dist(re);
+        bars.erase(bars.begin());
+        bars.push_back({bars.back().id + 1, value_dist(re)});
+
+        // Only the differences touch the document:
+        auto join = svg("rect").data(bars, [](const Bar& bar) { return bar.id; });
+        join.apply(svg,
+            [&](const Bar&) {
+                return $("<rect/>", {{"width", WIDTH / 20 - 2}, {"style", "fill: steelblue"}});
+            },
+            [&](Node& rect, const Bar& bar) {
+                // Records are referenced in place, so the index is the offset:
+                rect.attr("x", (&bar - bars.data()) * (WIDTH / 20));
+                rect.attr("y", HEIGHT - bar.value);
+                rect.attr("height", bar.value);
+            });
+    }
+
+    std::cout << $ << std::endl;
+}
@@ -14,8 +14,8 @@ int main()
     $("body")
     .append($("<svg/>", {
         {"id", "chart"},
-        {"width", std::to_string(WIDTH)},
-        {"height", std::to_string(HEIGHT)}
+        {"width", WIDTH},
+        {"height", HEIGHT}
     }));
 
     $("head")
@@ -32,19 +32,19 @@ int main()
 
     for (size_t x = 0; x <= WIDTH; x += WIDTH / 20) {
         auto line = $("<line/>", {
-            {"x1", std::to_string(x)},
-            {"y1", "0"},
-            {"x2", std::to_string(x)},
-            {"y2", std::to_string(HEIGHT)}
+            {"x1", x},
+            {"y1", 0},
+            {"x2", x},
+            {"y2", HEIGHT}
         });
         svg.append(line);
     }
     for (size_t y = 0; y <= HEIGHT; y += HEIGHT / 20) {
         auto line = $("<line/>", {
-            {"x1", "0"},
-            {"y1", std::to_string(y)},
-            {"x2", std::to_string(WIDTH)},
-            {"y2", std::to_string(y)}
+            {"x1", 0},
+            {"y1", y},
+            {"x2", WIDTH},
+            {"y2", y}
         });
         svg.append(line);
     }
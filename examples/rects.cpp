@@ -3,6 +3,7 @@
 #include <random>
 #include "core/collection.h"
 #include "core/html_node.h"
+#include "core/template.h"
 
 const size_t WIDTH = 1600;
 const size_t HEIGHT = 900;
@@ -24,6 +25,7 @@ std::string random_color()
 
 int main()
 {
+    using SeeQuery::Template;
     using SeeQuery::SeeQuery;
 
     // Create document:
@@ -48,6 +50,15 @@ int main()
 
     auto svg = $("svg");
 
+    // Compile the element shape once, fill in the slots for every rect:
+    Template rect($("<rect/>", {
+        {"x", Template::slot("x")},
+        {"y", Template::slot("y")},
+        {"width", Template::slot("width")},
+        {"height", Template::slot("height")},
+        {"style", Template::slot("style")}
+    }));
+
     std::uniform_int_distribution<size_t> x_dist(0, WIDTH);
     std::uniform_int_distribution<size_t> y_dist(0, HEIGHT);
     std::uniform_int_distribution<size_t> w_dist(10, WIDTH / 5);
@@ -66,7 +77,7 @@ int main()
             << "fill-opacity: 0.5; "
             << "stroke-opacity: 1.0;";
 
-        svg.append($("<rect/>", {
+        svg.append(rect({
             {"x", x},
             {"y", y},
             {"width", width},
@@ -0,0 +1,100 @@
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+#include "catch.hpp"
+#include "../core/batch_renderer.h"
+
+namespace
+{
+    void report(SeeQuery::SeeQuery& $, size_t i)
+    {
+        $("body").append($("<h1/>", {{"text", "Report " + std::to_string(i)}}));
+        $("body").append($("<svg/>"));
+        for (size_t k = 0; k < i % 20; ++k) {
+            $("svg").append($("<rect/>", {{"x", k}, {"width", i}}));
+        }
+    }
+    std::string read_file(const std::string& path)
+    {
+        std::ifstream in(path);
+        std::stringstream content;
+        content << in.rdbuf();
+        return content.str();
+    }
+}
+
+TEST_CASE("Batch rendering writes every document", "[batch_renderer]")
+{
+    char directory[] = "/tmp/seequery-batch-XXXXXX";
+    REQUIRE(mkdtemp(directory) != nullptr);
+    const size_t N = 200;
+    auto path = [&](size_t i) { return std::string(directory) + "/" + std::to_string(i) + ".html"; };
+
+    SeeQuery::ThreadPool pool(4);
+    SeeQuery::BatchRenderer renderer(pool, 6);
+    REQUIRE(renderer.maxInFlight() == 6);
+    size_t next = 0;
+    auto stats = renderer.run([&](SeeQuery::BatchRenderer::Job& job) {
+        if (next == N + 2) {
+            return false;
+        }
+        size_t i = next++;
+        if (i == N) {
+            job.build = [](SeeQuery::SeeQuery&) { throw std::runtime_error("broken template"); };
+            job.path = path(i);
+        } else if (i == N + 1) {
+            job.build = [i](SeeQuery::SeeQuery& $) { report($, i); };
+            job.path = std::string(directory) + "/missing/" + std::to_string(i) + ".html";
+        } else {
+            job.build = [i](SeeQuery::SeeQuery& $) { report($, i); };
+            job.path = path(i);
+        }
+        return true;
+    });
+
+    REQUIRE(stats.documents == N);
+    REQUIRE(stats.failed == 2);
+    REQUIRE(!stats.first_error.empty());
+    REQUIRE(stats.peak_in_flight <= 6);
+    REQUIRE(stats.seconds > 0);
+    REQUIRE(stats.documentsPerSecond() > 0);
+    size_t bytes = 0;
+    for (size_t i = 0; i < N; ++i) {
+        SeeQuery::SeeQuery $;
+        report($, i);
+        std::string content = read_file(path(i));
+        REQUIRE(content == $.serialize());
+        bytes += content.size();
+        std::remove(path(i).c_str());
+    }
+    REQUIRE(stats.bytes == bytes);
+    rmdir(directory);
+}
+TEST_CASE("A failing generator lets the running jobs finish", "[batch_renderer]")
+{
+    SeeQuery::ThreadPool pool(4);
+    SeeQuery::BatchRenderer renderer(pool, 8);
+    std::atomic<size_t> built{0};
+    size_t pulled = 0;
+    auto run = [&]() {
+        renderer.run([&](SeeQuery::BatchRenderer::Job& job) {
+            if (pulled == 20) {
+                throw std::runtime_error("generator failed");
+            }
+            ++pulled;
+            job.build = [&](SeeQuery::SeeQuery& $) {
+                usleep(1000);
+                report($, 1);
+                ++built;
+            };
+            job.path = "/dev/null";
+            return true;
+        });
+    };
+    REQUIRE_THROWS_AS(run(), std::runtime_error);
+    // All the jobs pulled before the failure have run to completion:
+    REQUIRE(built == 20);
+}
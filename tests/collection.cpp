@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <memory>
+#include <vector>
 #include "catch.hpp"
 #include "../core/collection.h"
 #include "../core/node.h"
@@ -28,6 +31,54 @@ TEST_CASE("Test selection by id/tag/class", "[collection][selection]")
     REQUIRE($("body").size() == 1);
     REQUIRE($("nothing").size() == 0);
 }
+TEST_CASE("Class selectors match any class token", "[collection][selection]")
+{
+    SeeQuery::SeeQuery $;
+    $("body")
+    .append($("<p/>", {{"class", "a b"}, {"id", "first"}}))
+    .append($("<p/>", {{"class", " b\tc "}, {"id", "second"}}))
+    .append($("<p/>", {{"class", "ab"}, {"id", "third"}}));
+
+    REQUIRE($(".a").size() == 1);
+    REQUIRE($(".b").size() == 2);
+    REQUIRE($(".c").attr("id") == "second");
+    REQUIRE($(".ab").attr("id") == "third");
+    REQUIRE($(".a.b").size() == 0);
+
+    // Tokens follow attribute updates:
+    $("#third").attr("class", "c a");
+    REQUIRE($(".a").size() == 2);
+    REQUIRE($(".ab").size() == 0);
+    $("#first").attr("class", SeeQuery::AttributeValue(7));
+    REQUIRE($(".a").size() == 1);
+    REQUIRE($(".7").size() == 1);
+}
+TEST_CASE("Class tokens belong to their document", "[collection][selection]")
+{
+    SeeQuery::SeeQuery a;
+    SeeQuery::SeeQuery b;
+    a("body").append(a("<p/>", {{"class", "x y"}}));
+    b("body").append(b("<p/>", {{"class", "z"}}));
+    REQUIRE(a.document().classTable().size() == 2);
+    REQUIRE(b.document().classTable().size() == 1);
+    REQUIRE(b.document().classTable().find("x") == SeeQuery::ClassList::NONE);
+
+    // Moved nodes take tokens of their new document:
+    SeeQuery::Node* p = a("p").get(0);
+    b("body").get(0)->append(p);
+    REQUIRE(b(".y").size() == 1);
+    REQUIRE(b(".z").size() == 1);
+    REQUIRE(a(".y").size() == 0);
+    REQUIRE(b.document().classTable().size() == 3);
+
+    // Nodes without a document match the attribute itself:
+    std::unique_ptr<SeeQuery::HtmlNode> loose{new SeeQuery::HtmlNode("div", {{"class", "u v"}})};
+    loose->append(new SeeQuery::HtmlNode("span", {{"class", "v"}}));
+    REQUIRE(loose->hasClass("u"));
+    REQUIRE(loose->classList().empty());
+    REQUIRE(loose->getElementsByClassName("v").size() == 1);
+    REQUIRE(loose->firstChild()->getElementsByClassName("v").size() == 1);
+}
 TEST_CASE("Test collection appending", "[collection][append]")
 {
     // Create document:
@@ -129,6 +180,182 @@ TEST_CASE("Inserting before", "[collection][before]")
     REQUIRE(body_children[3].attr("id") == "two");
 }
 
+TEST_CASE("Callbacks and traversal", "[collection][each]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<ul/>", {{"class", "list"}}));
+    for (int i = 0; i < 5; ++i) {
+        $(".list").append($("<li/>", {{"class", "item"}, {"id", "item-" + std::to_string(i)}, {"text", "item"}}));
+    }
+    auto items = $(".item");
+
+    int n = 0;
+    items.each([&](SeeQuery::Node& node) {
+        node.attr("data-index", n++);
+    });
+    REQUIRE(items[3].attr("data-index") == "3");
+    REQUIRE(items.get(3) == items[3].get(0));
+    REQUIRE(items.get(5) == nullptr);
+
+    auto ids = items.map([](SeeQuery::Node& node) { return node.attr("id"); });
+    REQUIRE(ids.size() == 5);
+    REQUIRE(ids[4] == "item-4");
+
+    auto odd = items.filter([](SeeQuery::Node& node) {
+        return node.attrValue("data-index").toInteger() % 2 == 1;
+    });
+    REQUIRE(odd.size() == 2);
+    REQUIRE(odd[1].attr("id") == "item-3");
+
+    REQUIRE(items.parent().size() == 1);
+    REQUIRE(items.parent().attr("class") == "list");
+    REQUIRE(items.closest("ul").size() == 1);
+    REQUIRE(items.closest(".item").size() == 5);
+    REQUIRE(items.closest("table").size() == 0);
+    REQUIRE($("body").find(".item").size() == 5);
+    REQUIRE($(".list").find("ul").size() == 0);
+    REQUIRE($("ul").find("#item-2").attr("id") == "item-2");
+
+    // Collections iterate over their nodes:
+    size_t count = 0;
+    for (SeeQuery::Node& node: items) {
+        count += node.attr("class") == "item";
+    }
+    REQUIRE(count == 5);
+    REQUIRE(std::find_if(items.begin(), items.end(), [](SeeQuery::Node& node) {
+        return node.attr("id") == "item-2";
+    })->attr("data-index") == "2");
+}
+TEST_CASE("Results are in document order without duplicates", "[collection][order]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<div/>", {{"id", "outer"}, {"class", "box"}}));
+    $("#outer").append($("<p/>", {{"id", "one"}}));
+    $("#outer").append($("<div/>", {{"id", "inner"}, {"class", "box"}}));
+    $("#inner").append($("<p/>", {{"id", "two"}}));
+    $("#outer").append($("<p/>", {{"id", "three"}}));
+
+    // The inner box comes first, its paragraph is also under the outer one:
+    auto boxes = $("#inner").add($("#outer"));
+    REQUIRE(boxes.size() == 2);
+    REQUIRE(boxes[0].attr("id") == "outer");
+    auto paragraphs = $(".box")("p");
+    REQUIRE(paragraphs.size() == 3);
+    REQUIRE(paragraphs[0].attr("id") == "one");
+    REQUIRE(paragraphs[1].attr("id") == "two");
+    REQUIRE(paragraphs[2].attr("id") == "three");
+    REQUIRE($(".box").find("p").size() == 3);
+    REQUIRE($(".box").find("p")[1].attr("id") == "two");
+
+    REQUIRE(paragraphs.add($("p")).size() == 3);
+    REQUIRE(paragraphs.exclude($("#two")).size() == 2);
+    REQUIRE(paragraphs.exclude("#two")[1].attr("id") == "three");
+    REQUIRE(paragraphs.is("#three"));
+    REQUIRE_FALSE(paragraphs.is(".box"));
+    REQUIRE(paragraphs.is($("#inner").find("p")));
+    REQUIRE_FALSE(paragraphs.is($(".box")));
+}
+TEST_CASE("Keyed data join", "[collection][data]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<ul/>"));
+    auto list = $("ul");
+    struct Record
+    {
+        std::string name;
+        int value;
+    };
+    auto name_of = [](const Record& record) { return record.name; };
+    auto create = [&](const Record&) { return $("<li/>"); };
+    size_t updates = 0;
+    auto update = [&](SeeQuery::Node& node, const Record& record) {
+        node.attr("value", record.value);
+        ++updates;
+    };
+
+    std::vector<Record> records = {{"a", 1}, {"b", 2}, {"c", 3}};
+    auto first = list("li").data(records, name_of);
+    REQUIRE(first.enter().size() == 3);
+    REQUIRE(first.update().empty());
+    REQUIRE(first.exit().size() == 0);
+    first.apply(list, create, update);
+    REQUIRE($("li").size() == 3);
+    REQUIRE($("li")[1].attr("data-key") == "b");
+    REQUIRE(updates == 3);
+
+    records = {{"c", 30}, {"d", 4}, {"a", 10}, {"d", 5}};
+    auto second = list("li").data(records, name_of);
+    REQUIRE(second.enter().size() == 2); // "d", and "d" again
+    REQUIRE(second.update().size() == 2);
+    REQUIRE(second.update()[0].node->attr("data-key") == "c");
+    REQUIRE(second.exit().size() == 1);
+    REQUIRE(second.exit().attr("data-key") == "b");
+    updates = 0;
+    second.apply(list, create, update);
+    REQUIRE(updates == 4);
+    REQUIRE($("li").size() == 4);
+    REQUIRE($("li")[0].attr("value") == "10");
+    REQUIRE($("li")[1].attr("value") == "30");
+    REQUIRE($("li")[3].attr("data-key") == "d");
+
+    // Entering elements are not cloned into several parents:
+    $("body").append($("<ul/>"));
+    auto third = list("li").data(records, name_of);
+    auto lists = $("ul");
+    REQUIRE(lists.size() == 2);
+    REQUIRE_THROWS_AS(third.apply(lists, create, update), std::invalid_argument);
+    REQUIRE($("li").size() == 4);
+}
+TEST_CASE("Query results are cached until the document changes", "[collection][query_cache]")
+{
+    SeeQuery::SeeQuery $;
+    auto& cache = $.document().queryCache();
+    $("body").append($("<p/>", {{"class", "row"}, {"id", "first"}}));
+
+    REQUIRE($(".row").size() == 1);
+    REQUIRE(cache.misses() == 2); // "body" (before the append), ".row"
+    REQUIRE($(".row").size() == 1);
+    REQUIRE($(".row").size() == 1);
+    REQUIRE(cache.hits() == 2);
+    REQUIRE(cache.misses() == 2);
+
+    // Every kind of mutation invalidates the results:
+    uint64_t generation = $.document().generation();
+    $("body").append($("<p/>", {{"class", "row"}, {"id", "second"}}));
+    REQUIRE($.document().generation() != generation);
+    REQUIRE($(".row").size() == 2);
+
+    $("#first").attr("class", "column");
+    REQUIRE($(".row").size() == 1);
+    REQUIRE($(".row").attr("id") == "second");
+
+    $("#second").remove();
+    REQUIRE($(".row").size() == 0);
+
+    generation = $.document().generation();
+    $("#first").children().remove();
+    $("#first").get(0)->append(new SeeQuery::TextNode("text"));
+    REQUIRE($.document().generation() != generation);
+
+    // Queries from another element are cached separately:
+    REQUIRE($("body")("p").size() == 1);
+    REQUIRE($("p").size() == 1);
+
+    // The capacity bounds the stored nodes, each result counting one more:
+    REQUIRE(cache.nodes() > cache.size());
+    cache.capacity(2);
+    REQUIRE(cache.size() == 1); // the last "p" result, one node
+    REQUIRE(cache.nodes() == 2);
+    cache.capacity(1);
+    REQUIRE(cache.size() == 0);
+    REQUIRE($("p").size() == 1); // too large to keep
+    REQUIRE(cache.size() == 0);
+    cache.capacity(0);
+    size_t misses = cache.misses();
+    REQUIRE($("p").size() == 1);
+    REQUIRE($("p").size() == 1);
+    REQUIRE(cache.misses() == misses + 2);
+}
 TEST_CASE("Root-reference count", "[collection][reference_count]")
 {
     using SeeQuery::SeeQuery;
@@ -147,4 +374,40 @@ TEST_CASE("Root-reference count", "[collection][reference_count]")
     // container changed changed its root (was root, became embedded),
     // so it must be deleted from the root counter table
     REQUIRE(SeeQuery::roots() == 1);
-}
\ No newline at end of file
+}
+TEST_CASE("Document string pool", "[collection][string_pool]")
+{
+    SeeQuery::SeeQuery $;
+    $.document().internStrings();
+
+    for (int i = 0; i < 3; ++i) {
+        $("body").append($("<div/>", {
+            {"class", "cell"},
+            {"style", "fill: red"},
+            {"text", "label"}
+        }));
+    }
+    auto cells = $(".cell");
+    REQUIRE(cells.size() == 3);
+    // Equal values are stored once:
+    REQUIRE(cells[0].attrValue("style").shared() == cells[2].attrValue("style").shared());
+    REQUIRE($.document().stringPool().size() == 3);
+
+    // Modifying a value through `attr()` does not affect other elements:
+    cells[1].attr("style", "fill: blue");
+    REQUIRE(cells[0].attr("style") == "fill: red");
+    REQUIRE(cells[1].attr("style") == "fill: blue");
+    REQUIRE(cells[2].attr("style") == "fill: red");
+    REQUIRE($.document().stringPool().size() == 4);
+
+    cells[1].attr("style", "fill: red");
+    REQUIRE($.document().stringPool().prune() == 1);
+    REQUIRE($.document().stringPool().size() == 3);
+
+    // Without the pool, strings are held inline, not behind a shared handle:
+    $.document().internStrings(false);
+    cells[1].attr("style", "fill: green");
+    REQUIRE(cells[1].attrValue("style").shared() == nullptr);
+    REQUIRE(*cells[1].attrValue("style").string() == "fill: green");
+    REQUIRE(cells[0].attrValue("style").shared() != nullptr);
+}
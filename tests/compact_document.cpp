@@ -0,0 +1,143 @@
+#include <memory>
+#include <stdexcept>
+#include "catch.hpp"
+#include "../core/collection.h"
+#include "../core/compact_collection.h"
+#include "../core/compact_document.h"
+#include "../core/dom.h"
+#include "../core/html_node.h"
+#include "../core/text_node.h"
+
+using SeeQuery::CompactCollection;
+using SeeQuery::CompactDocument;
+using SeeQuery::HtmlNode;
+using SeeQuery::TextNode;
+using SeeQuery::Node;
+
+TEST_CASE("Import a node tree into compact storage", "[compact_document]")
+{
+    std::unique_ptr<HtmlNode> body{new HtmlNode("body")};
+    body->append(new HtmlNode("div", {{"id", "one"}}));
+    body->append(new HtmlNode("div", {{"class", "row"}, {"text", "Hello"}}));
+    body->firstChild()->append(new HtmlNode("p", {{"class", "row"}}));
+
+    CompactDocument document(*body);
+    auto root = document.root();
+    REQUIRE(document.size() == 5);
+    REQUIRE(document.tagName(root) == "body");
+    REQUIRE(document.serialize(root) == body->serialize());
+
+    REQUIRE(document.getElementsByTagName(root, "div").size() == 2);
+    REQUIRE(document.getElementsByTagName(root, "p").size() == 1);
+    REQUIRE(document.getElementsByTagName(root, "span").empty());
+    REQUIRE(document.getElementsByClassName(root, "row").size() == 2);
+
+    auto one = document.getElementById(root, "one");
+    REQUIRE(one != CompactDocument::NONE);
+    REQUIRE(document.tagName(document.firstChild(one)) == "p");
+    REQUIRE(document.getElementById(root, "two") == CompactDocument::NONE);
+
+    SECTION("Update attributes")
+    {
+        auto p = document.firstChild(one);
+        document.attr(one, "title", "first");
+        document.attr(p, "class", "cell wide");
+        REQUIRE(document.attr(one, "id") == "one");
+        REQUIRE(document.attr(one, "title") == "first");
+        REQUIRE(document.attr(p, "class") == "cell wide");
+        REQUIRE(document.getElementsByClassName(root, "row").size() == 1);
+        REQUIRE(document.getElementsByClassName(root, "wide").size() == 1);
+    }
+    SECTION("Convert back to a node tree")
+    {
+        std::unique_ptr<Node> copy{document.toNode(root)};
+        REQUIRE(copy->serialize() == body->serialize());
+    }
+}
+TEST_CASE("Build a compact document", "[compact_document]")
+{
+    CompactDocument document;
+    auto svg = document.createElement("svg");
+    for (int i = 0; i < 3; ++i) {
+        document.append(svg, document.createElement("rect", {{"x", i}}));
+    }
+    document.append(document.lastChild(svg), document.createText("label"));
+
+    REQUIRE(document.size() == 5);
+    REQUIRE(document.nodeType(svg) == Node::ELEMENT_NODE);
+    REQUIRE(document.serialize(svg) ==
+        "<svg>\n"
+        "  <rect x=\"0\"/>\n"
+        "  <rect x=\"1\"/>\n"
+        "  <rect x=\"2\">\n"
+        "    label\n"
+        "  </rect>\n"
+        "</svg>");
+}
+TEST_CASE("A compact document keeps the doctype of a Dom", "[compact_document]")
+{
+    SeeQuery::Dom dom;
+    dom.lastChild()->append(new HtmlNode("p", {{"text", "Hello"}}));
+
+    CompactDocument document(dom);
+    REQUIRE(document.doctype() == dom.doctype());
+    REQUIRE(document.serialize(document.root()) == dom.serialize());
+    // Only the root carries the doctype:
+    auto body = document.lastChild(document.root());
+    REQUIRE(document.serialize(body) == dom.lastChild()->serialize());
+
+    std::unique_ptr<Node> copy{document.toNode(document.root())};
+    REQUIRE(dynamic_cast<SeeQuery::Dom*>(copy.get()) != nullptr);
+    REQUIRE(copy->serialize() == dom.serialize());
+}
+TEST_CASE("Appending checks the node ids", "[compact_document]")
+{
+    CompactDocument document;
+    auto p = document.createElement("p");
+    auto span = document.createElement("span");
+    auto text = document.createText("detached");
+    document.append(p, span);
+
+    REQUIRE_THROWS_AS(document.append(p, span), std::invalid_argument); // already attached
+    REQUIRE_THROWS_AS(document.append(span, p), std::invalid_argument); // an ancestor
+    REQUIRE_THROWS_AS(document.append(text, text), std::invalid_argument); // itself
+    REQUIRE_THROWS_AS(document.append(p, 99), std::invalid_argument);
+    REQUIRE_THROWS_AS(document.append(99, text), std::invalid_argument);
+    REQUIRE(document.serialize(p) == "<p>\n  <span/>\n</p>");
+
+    REQUIRE_THROWS_AS(document.parent(99), std::invalid_argument);
+    REQUIRE_THROWS_AS(document.nextSibling(CompactDocument::NONE), std::invalid_argument);
+    REQUIRE_THROWS_AS(document.attr(99, "id"), std::invalid_argument);
+    REQUIRE_THROWS_AS(document.getElementsByTagName(99, "p"), std::invalid_argument);
+    REQUIRE_THROWS_AS(document.serialize(99), std::invalid_argument);
+}
+TEST_CASE("Query a compact document", "[compact_document]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<svg/>"));
+    for (int i = 0; i < 20; ++i) {
+        $("svg").append($("<rect/>", {{"id", "r" + std::to_string(i)}, {"class", i % 2 ? "odd" : "even"}}));
+    }
+    $("body").append($("<p/>", {{"class", "odd"}, {"text", "note"}}));
+
+    CompactDocument document(*$("html").get(0));
+    CompactCollection _(document);
+    REQUIRE(_.size() == 1);
+    REQUIRE(_("rect").size() == 20);
+    REQUIRE(_(".odd").size() == 11);
+    REQUIRE(_(".odd").serialize() == $(".odd").serialize());
+    REQUIRE(_("#r7").attr("class") == "odd");
+    REQUIRE(_("#r99").size() == 0);
+    REQUIRE(_("svg")(".even").size() == 10);
+    REQUIRE(_("svg").children().size() == 20);
+    REQUIRE(_("rect").parent().size() == 1);
+    REQUIRE(_("rect")[3].attr("id") == "r3");
+    REQUIRE(_("rect").get(20) == CompactDocument::NONE);
+    REQUIRE(_("body").find(".odd").serialize() == $("body").find(".odd").serialize());
+    REQUIRE(_("<p/>").size() == 0);
+
+    // Nested elements give each match once, in document order:
+    CompactCollection nested(document, {_("svg").get(0), _("body").get(0)});
+    REQUIRE(nested(".odd").serialize() == $("body").add($("svg"))(".odd").serialize());
+    REQUIRE(nested.find("rect").size() == 20);
+}
@@ -0,0 +1,108 @@
+#include <thread>
+#include <vector>
+#include <atomic>
+#include "catch.hpp"
+#include "../core/collection.h"
+#include "../core/template.h"
+
+namespace
+{
+    const size_t NUM_OF_THREADS = 8;
+
+    std::string build_document(size_t rows)
+    {
+        SeeQuery::SeeQuery $;
+        $.document().internStrings();
+        $("body").append($("<table/>", {{"id", "grid"}}));
+        auto table = $("#grid");
+        for (size_t i = 0; i < rows; ++i) {
+            table.append($("<tr/>", {
+                {"class", "row"},
+                {"id", "row-" + std::to_string(i)},
+                {"text", "row"}
+            }));
+        }
+        $(".row").attr("style", "height: 10px");
+        $("#row-0").remove();
+        return $.serialize();
+    }
+}
+
+TEST_CASE("Independent documents are built in parallel", "[concurrency]")
+{
+    const std::string expected = build_document(200);
+
+    std::atomic<size_t> matches(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < NUM_OF_THREADS; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 20; ++i) {
+                if (build_document(200) == expected) {
+                    ++matches;
+                }
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    REQUIRE(matches == NUM_OF_THREADS * 20);
+}
+TEST_CASE("Frozen document is queried from many threads", "[concurrency]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<div/>", {{"id", "container"}}));
+    auto container = $("#container");
+    for (int i = 0; i < 500; ++i) {
+        container.append($("<p/>", {{"class", "cell"}, {"text", "cell"}}));
+    }
+    const size_t roots = SeeQuery::SeeQuery::roots();
+    const std::string expected = $.serialize();
+
+    std::atomic<size_t> matches(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < NUM_OF_THREADS; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 50; ++i) {
+                auto cells = $(".cell");
+                auto copy = cells;
+                if (copy.size() == 500 && $("#container").children().size() == 500
+                        && $("p")[499].attr("class") == "cell") {
+                    ++matches;
+                }
+            }
+            if ($.serialize() == expected) {
+                ++matches;
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    REQUIRE(matches == NUM_OF_THREADS * 51);
+    REQUIRE(SeeQuery::SeeQuery::roots() == roots);
+}
+TEST_CASE("Parallel query matches the sequential one", "[concurrency][thread_pool]")
+{
+    SeeQuery::SeeQuery $;
+    for (int i = 0; i < 20; ++i) {
+        $("body").append($("<div/>", {{"class", "section"}, {"id", "section-" + std::to_string(i)}}));
+    }
+    auto sections = $(".section");
+    for (int i = 0; i < 50; ++i) {
+        sections.append($("<p/>", {{"class", "cell"}, {"id", "cell"}, {"text", "cell"}}));
+    }
+    SeeQuery::ThreadPool pool(4);
+
+    for (std::string query: {".cell", "p", "div", ".section", "#cell", "#section-7", "#none", "?"}) {
+        auto expected = $(query);
+        auto actual = $(query, pool);
+        REQUIRE(actual.size() == expected.size());
+        REQUIRE(actual.serialize() == expected.serialize());
+        // Every query on a collection is run per element and merged in order:
+        REQUIRE(sections(query, pool).serialize() == sections(query).serialize());
+    }
+    REQUIRE($("#cell", pool).size() == 1);
+    REQUIRE(sections("#cell", pool).size() == 20);
+    REQUIRE($("<p/>", pool).size() == 1);
+}
@@ -0,0 +1,50 @@
+#include <zlib.h>
+#include "catch.hpp"
+#include "../core/collection.h"
+#include "../core/deflate_writer.h"
+
+namespace
+{
+    std::string inflate_gzip(const std::string& compressed)
+    {
+        z_stream stream{};
+        inflateInit2(&stream, 15 + 16);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+        stream.avail_in = static_cast<uInt>(compressed.size());
+        std::string result;
+        char buffer[4096];
+        int status;
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(buffer);
+            stream.avail_out = sizeof(buffer);
+            status = inflate(&stream, Z_NO_FLUSH);
+            result.append(buffer, sizeof(buffer) - stream.avail_out);
+        } while (status == Z_OK);
+        inflateEnd(&stream);
+        return status == Z_STREAM_END ? result : std::string();
+    }
+}
+
+TEST_CASE("Compress serialized output", "[writer][deflate_writer]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<svg/>"));
+    auto svg = $("svg");
+    for (int i = 0; i < 1000; ++i) {
+        svg.append($("<rect/>", {
+            {"x", i},
+            {"style", "fill: red; stroke: black"}
+        }));
+    }
+    std::string expected = $.serialize();
+
+    SeeQuery::StringWriter compressed;
+    SeeQuery::DeflateWriter gzip(compressed, 6, SeeQuery::DeflateWriter::GZIP, 1024);
+    $.serialize(gzip);
+    gzip.finish();
+
+    REQUIRE(gzip.bytesIn() == expected.size());
+    REQUIRE(gzip.bytesOut() == compressed.str().size());
+    REQUIRE(compressed.str().size() < expected.size() / 4);
+    REQUIRE(inflate_gzip(compressed.str()) == expected);
+}
@@ -1,9 +1,22 @@
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <memory>
+#include <vector>
 #include "catch.hpp"
+#include "../core/document.h"
 #include "../core/html_node.h"
 #include "../core/node.h"
+#include "../core/text_node.h"
 
 using SeeQuery::HtmlNode;
 using SeeQuery::Node;
+using SeeQuery::TextNode;
 
 TEST_CASE("Set/get next/previous siblings", "[html_node][sibling]")
 {
@@ -208,6 +221,35 @@ TEST_CASE("Detaching a node", "[html_node][detach]")
         delete second_child;
     }
 }
+TEST_CASE("Detaching the last child", "[html_node][detach]")
+{
+    std::unique_ptr<HtmlNode> node(new HtmlNode("root"));
+    Node* a = new HtmlNode("a");
+    Node* b = new HtmlNode("b");
+    Node* c = new HtmlNode("c");
+    node->append(a);
+    node->append(b);
+    node->append(c);
+
+    c->detach();
+    delete c;
+    REQUIRE(node->lastChild() == b);
+    REQUIRE(b->nextSibling() == nullptr);
+
+    Node* d = new HtmlNode("d");
+    node->append(d);
+    REQUIRE(node->lastChild() == d);
+    REQUIRE(b->nextSibling() == d);
+    REQUIRE(d->prevSibling() == b);
+    REQUIRE(node->getChildren().size() == 3);
+
+    Node* e = new HtmlNode("e");
+    node->prepend(e);
+    REQUIRE(node->firstChild() == e);
+    REQUIRE(e->parent() == node.get());
+    REQUIRE(d->parent() == node.get());
+    REQUIRE(node->lastChild() == d);
+}
 TEST_CASE("Reattaching a node", "[html_node][reattach]")
 {
     std::unique_ptr<HtmlNode> node(new HtmlNode("root"));
@@ -230,6 +272,347 @@ TEST_CASE("Reattaching a node", "[html_node][reattach]")
     node->append(child2);
     REQUIRE(node->getElementsByClassName("child").size() == 3);
 }
+TEST_CASE("Numeric attribute values", "[html_node][attribute]")
+{
+    using SeeQuery::AttributeValue;
+
+    std::unique_ptr<HtmlNode> rect{new HtmlNode("rect", {
+        {"x", 10},
+        {"y", -3},
+        {"width", 2.5},
+        {"height", 0.1},
+        {"style", "fill: red"}
+    })};
+    REQUIRE(rect->attrValue("x").type() == AttributeValue::INTEGER);
+    REQUIRE(rect->attrValue("width").type() == AttributeValue::REAL);
+    REQUIRE(rect->attrValue("style").type() == AttributeValue::STRING);
+
+    // Numbers are formatted on demand, in the shortest round-trip form:
+    REQUIRE(rect->attr("x") == "10");
+    REQUIRE(rect->attr("y") == "-3");
+    REQUIRE(rect->attr("width") == "2.5");
+    REQUIRE(rect->attr("height") == "0.1");
+    REQUIRE(AttributeValue(1.0 / 3).str() == "0.3333333333333333");
+    REQUIRE(AttributeValue(1e21).str() == "1e+21");
+    REQUIRE(AttributeValue(-42.0).str() == "-42");
+    REQUIRE(AttributeValue(1e-5).str() == "1e-05");
+    REQUIRE(AttributeValue(123456.5).str() == "123456.5");
+    REQUIRE(AttributeValue(5e-324).str() == "5e-324");
+    REQUIRE(AttributeValue(1.7976931348623157e308).str() == "1.7976931348623157e+308");
+    REQUIRE(AttributeValue(-std::numeric_limits<double>::infinity()).str() == "-inf");
+
+    // Every double reads back from its formatted form:
+    uint64_t bits = 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < 10000; ++i) {
+        bits = bits * 6364136223846793005ull + 1442695040888963407ull;
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        if (std::isfinite(value)) {
+            REQUIRE(std::strtod(AttributeValue(value).str().c_str(), nullptr) == value);
+        }
+    }
+
+    // Doubles out of the integer range clamp instead of overflowing:
+    REQUIRE(AttributeValue(1e300).toInteger() == std::numeric_limits<int64_t>::max());
+    REQUIRE(AttributeValue(-1e300).toInteger() == std::numeric_limits<int64_t>::min());
+    REQUIRE(AttributeValue(std::numeric_limits<double>::quiet_NaN()).toInteger() == 0);
+
+    // Numeric update and read back without string parsing:
+    rect->attr("x", rect->attrValue("x").toInteger() + 5);
+    REQUIRE(rect->attrValue("x").toInteger() == 15);
+    REQUIRE(rect->attr("x") == "15");
+
+    // String values are still parsed on numeric read:
+    rect->attr("y", "7.25");
+    REQUIRE(rect->attrValue("y").toReal() == 7.25);
+}
+TEST_CASE("Descendant summaries follow insertions and attributes", "[html_node][summary]")
+{
+    HtmlNode root("root");
+    HtmlNode* left = new HtmlNode("section");
+    HtmlNode* right = new HtmlNode("section");
+    root.append(left);
+    root.append(right);
+    HtmlNode* item = new HtmlNode("item", {{"class", "x y"}});
+    left->append(item);
+    REQUIRE((root.summary() & item->summary()) == item->summary());
+    REQUIRE((left->summary() & item->summary()) == item->summary());
+
+    // Moved, renamed and re-classed nodes are still found:
+    right->prepend(item);
+    item->attr("id", "moved");
+    item->attr("class", "z");
+    REQUIRE((right->summary() & item->summary()) == item->summary());
+    REQUIRE(root.getElementById("moved") == item);
+    REQUIRE(right->getElementsByClassName("z").size() == 1);
+    REQUIRE(left->getElementsByClassName("z").empty());
+    REQUIRE(root.getElementsByTagName("item").size() == 1);
+
+    left->nextSibling(new HtmlNode("aside", {{"id", "side"}}));
+    REQUIRE(root.getElementById("side") != nullptr);
+    REQUIRE(root.getElementsByTagName("aside").size() == 1);
+}
+TEST_CASE("Ids stay out of the summaries", "[html_node][summary]")
+{
+    auto document = std::make_shared<SeeQuery::Document>();
+    HtmlNode root("root", {}, document);
+    HtmlNode* list = new HtmlNode("section", {}, document);
+    HtmlNode* chart = new HtmlNode("section", {{"class", "chart"}}, document);
+    root.append(list);
+    root.append(chart);
+    for (int i = 0; i < 1000; ++i) {
+        list->append(new HtmlNode("row", {{"id", "row-" + std::to_string(i)}, {"class", "row"}}, document));
+    }
+    chart->append(new HtmlNode("bar", {{"class", "bar"}, {"id", "bar"}}, document));
+
+    // A thousand ids leave the summary of the list with its tags and class
+    // only, so queries for the chart skip the list subtree:
+    REQUIRE(std::bitset<64>(list->summary()).count() <= 3);
+    uint64_t bar_bits = chart->firstChild()->summary();
+    REQUIRE((list->summary() & bar_bits) != bar_bits);
+    REQUIRE(root.getElementsByClassName("bar").size() == 1);
+    REQUIRE(root.getElementsByTagName("bar").size() == 1);
+
+    // Ids are looked up in the document, within the subtree queried:
+    REQUIRE(root.getElementById("row-500") == list->childAt(500));
+    REQUIRE(chart->getElementById("row-500") == nullptr);
+    REQUIRE(list->getElementById("bar") == nullptr);
+
+    // The first in document order wins, and changes are followed:
+    list->childAt(10)->attr("id", "row-20");
+    REQUIRE(root.getElementById("row-20") == list->childAt(10));
+    REQUIRE(root.getElementById("row-10") == nullptr);
+    static_cast<HtmlNode*>(list->childAt(10))->removeAttr("id");
+    REQUIRE(root.getElementById("row-20") == list->childAt(20));
+    chart->append(list->childAt(20));
+    REQUIRE(chart->getElementById("row-20") == chart->lastChild());
+    delete chart->lastChild()->detach();
+    REQUIRE(root.getElementById("row-20") == nullptr);
+    REQUIRE(document->elementsById("row-20").empty());
+}
+TEST_CASE("Child and descendant iterators", "[html_node][iterator]")
+{
+    HtmlNode root("root");
+    REQUIRE(root.childNodes().empty());
+    REQUIRE(root.descendants().empty());
+    for (int i = 0; i < 3; ++i) {
+        HtmlNode* child = new HtmlNode("child", {{"id", i}});
+        child->append(new HtmlNode("leaf"));
+        root.append(child);
+    }
+
+    std::vector<std::string> ids;
+    for (Node& child: root.childNodes()) {
+        ids.push_back(child.attr("id"));
+    }
+    REQUIRE(ids == std::vector<std::string>({"0", "1", "2"}));
+
+    auto children = root.childNodes();
+    REQUIRE(std::distance(children.begin(), children.end()) == 3);
+    auto last = children.end();
+    --last;
+    REQUIRE(last->attr("id") == "2");
+    std::reverse_iterator<SeeQuery::ChildIterator> reversed(children.end());
+    REQUIRE(reversed->attr("id") == "2");
+    REQUIRE((++reversed)->attr("id") == "1");
+
+    std::vector<std::string> order;
+    for (Node& node: root.descendants()) {
+        order.push_back(static_cast<HtmlNode&>(node).tagName());
+    }
+    REQUIRE(order == std::vector<std::string>({"child", "leaf", "child", "leaf", "child", "leaf"}));
+    auto leaves = std::count_if(root.descendants().begin(), root.descendants().end(),
+        [](Node& node) { return !node.firstChild(); });
+    REQUIRE(leaves == 3);
+    // A subtree does not leak into its siblings:
+    REQUIRE(std::distance(root.firstChild()->descendants().begin(), root.firstChild()->descendants().end()) == 1);
+}
+TEST_CASE("Text ropes and normalization", "[html_node][text]")
+{
+    HtmlNode style("style");
+    style.appendText("a{}");
+    for (int i = 0; i < 1000; ++i) {
+        style.appendText(std::string(100, 'x'));
+    }
+    TextNode* css = static_cast<TextNode*>(style.firstChild());
+    REQUIRE(style.firstChild() == style.lastChild());
+    REQUIRE(css->length() == 3 + 100 * 1000);
+    REQUIRE(css->text().size() == css->length());
+    // Small appends are merged, large ones are chained:
+    REQUIRE(css->chunks() < 1000);
+    REQUIRE(css->chunks() > 1);
+
+    // Copies share the chunks and serialize the same:
+    std::unique_ptr<Node> copy{css->clone()};
+    REQUIRE(copy->serialize() == css->serialize());
+    REQUIRE(css->serialize() == css->text());
+
+    HtmlNode p("p");
+    p.append(new TextNode("Hello"));
+    p.append(new TextNode(""));
+    p.append(new TextNode(", "));
+    p.append(new HtmlNode("br"));
+    p.append(new TextNode("world"));
+    p.append(new TextNode("!"));
+    p.normalize();
+    REQUIRE(p.getChildren().size() == 3);
+    REQUIRE(p.firstChild()->serialize() == "Hello, ");
+    REQUIRE(p.lastChild()->serialize() == "world!");
+    // Merged small appends stay in the first chunk:
+    REQUIRE(static_cast<TextNode*>(p.firstChild())->chunks() == 1);
+    REQUIRE(static_cast<TextNode*>(p.firstChild())->length() == 7);
+}
+TEST_CASE("Text content and markup", "[html_node][text]")
+{
+    HtmlNode div("div", {{"class", "note"}});
+    div.append(new TextNode("Hello, "));
+    HtmlNode* b = new HtmlNode("b", {{"text", "bold"}});
+    b->append(new HtmlNode("br"));
+    div.append(b);
+    div.append(new TextNode(" world"));
+
+    REQUIRE(div.text() == "Hello, bold world");
+    REQUIRE(b->text() == "bold");
+    REQUIRE(HtmlNode("empty").text().empty());
+    REQUIRE(div.html() == div.serialize());
+    REQUIRE(div.html() == "<div class=\"note\">\n  Hello, \n  <b>\n    bold\n    <br/>\n  </b>\n   world\n</div>");
+}
+TEST_CASE("Document order labels follow insertions", "[html_node][order]")
+{
+    HtmlNode root("root");
+    std::vector<Node*> nodes(1, &root);
+    unsigned seed = 1;
+    auto random = [&](size_t n) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 8) % n;
+    };
+    // Many insertions at the same places exhaust the gaps between labels:
+    for (int i = 0; i < 3000; ++i) {
+        Node* target = nodes[random(nodes.size())];
+        Node* node = new HtmlNode("n");
+        if (i % 7 == 0) {
+            node->append(new HtmlNode("leaf")); // a subtree
+        }
+        switch (target == &root ? random(2) : random(4)) {
+        case 0: target->append(node); break;
+        case 1: target->prepend(node); break;
+        case 2: target->nextSibling(node); break;
+        default: target->prevSibling(node); break;
+        }
+        nodes.push_back(node);
+        if (i % 50 == 49) {
+            // Move a subtree elsewhere:
+            Node* moved = nodes[1 + random(nodes.size() - 1)];
+            if (moved->parent() && moved->firstChild() == nullptr) {
+                moved->detach();
+                root.firstChild()->prevSibling(moved);
+            }
+        }
+    }
+    std::vector<Node*> order(1, &root);
+    for (Node& node: root.descendants()) {
+        order.push_back(&node);
+    }
+    REQUIRE(order.size() == 1 + 3000 + 3000 / 7 + 1);
+    for (size_t i = 1; i < order.size(); ++i) {
+        REQUIRE(order[i - 1]->precedes(*order[i]));
+        REQUIRE_FALSE(order[i]->precedes(*order[i - 1]));
+    }
+
+    // Sorting by labels restores document order and drops duplicates:
+    std::vector<Node*> shuffled(order);
+    shuffled.insert(shuffled.end(), order.begin(), order.begin() + 100);
+    std::reverse(shuffled.begin(), shuffled.end());
+    Node::sortInDocumentOrder(shuffled);
+    REQUIRE(shuffled == order);
+    std::vector<Node*> few(order.rbegin(), order.rbegin() + 10);
+    few.push_back(order.back());
+    Node::sortInDocumentOrder(few);
+    REQUIRE(few == std::vector<Node*>(order.end() - 10, order.end()));
+}
+TEST_CASE("Positional child index", "[html_node][child_index]")
+{
+    auto document = std::make_shared<SeeQuery::Document>();
+    HtmlNode root("g", {}, document);
+    std::vector<Node*> expected;
+    for (int i = 0; i < 1000; ++i) {
+        Node* child = new HtmlNode("rect");
+        root.append(child);
+        expected.push_back(child);
+    }
+    root.indexChildren();
+    REQUIRE(root.indexesChildren());
+    REQUIRE(root.childCount() == 1000);
+
+    unsigned seed = 7;
+    auto random = [&](size_t n) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 8) % n;
+    };
+    // The index follows insertions (at both ends, in the middle, by
+    // position) and removals:
+    for (int i = 0; i < 5000; ++i) {
+        size_t at = random(expected.size() + 1);
+        if (i % 3 == 2 && !expected.empty()) {
+            at = std::min(at, expected.size() - 1);
+            delete expected[at]->detach();
+            expected.erase(expected.begin() + at);
+            continue;
+        }
+        Node* child = new HtmlNode("circle");
+        switch (i % 4) {
+        case 0: root.insertChild(at, child); break;
+        case 1: root.append(child); at = expected.size(); break;
+        case 2: root.prepend(child); at = 0; break;
+        default:
+            if (at < expected.size()) {
+                expected[at]->nextSibling(child);
+                ++at;
+            } else {
+                root.append(child);
+            }
+        }
+        expected.insert(expected.begin() + at, child);
+    }
+    REQUIRE(root.childCount() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        REQUIRE(root.childAt(i) == expected[i]);
+        REQUIRE(expected[i]->index() == i);
+    }
+    REQUIRE(root.childAt(expected.size()) == nullptr);
+    std::vector<Node*> children;
+    for (Node& child: root.childNodes()) {
+        children.push_back(&child);
+    }
+    REQUIRE(children == expected);
+
+    // Without the index, the same answers by walking the children:
+    root.indexChildren(false);
+    REQUIRE(root.childCount() == expected.size());
+    REQUIRE(root.childAt(17) == expected[17]);
+    REQUIRE(expected[17]->index() == 17);
+    while (root.firstChild()) {
+        delete root.firstChild()->detach();
+    }
+    root.indexChildren();
+    REQUIRE(root.childCount() == 0);
+    root.insertChild(5, new HtmlNode("a"));
+    REQUIRE(root.childCount() == 1);
+    REQUIRE(root.childAt(0)->index() == 0);
+
+    // The index is kept by the document and follows the node:
+    REQUIRE(document->childIndex(&root) != nullptr);
+    auto other = std::make_shared<SeeQuery::Document>();
+    root.ownerDocument(other);
+    REQUIRE(document->childIndex(&root) == nullptr);
+    REQUIRE(other->childIndex(&root) != nullptr);
+    REQUIRE(root.indexesChildren());
+    root.ownerDocument(nullptr);
+    REQUIRE(other->childIndex(&root) == nullptr);
+    REQUIRE_FALSE(root.indexesChildren());
+    REQUIRE(root.childCount() == 1);
+    REQUIRE_THROWS_AS(root.indexChildren(), std::logic_error);
+}
 TEST_CASE("Performance test: appending/prepending items in a cycle", "[html_node][performance]")
 {
     const size_t NUM_OF_ITEMS = 100 * 1000;
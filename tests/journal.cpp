@@ -0,0 +1,67 @@
+#include <vector>
+#include "catch.hpp"
+#include "../core/collection.h"
+#include "../core/journal.h"
+
+using SeeQuery::Journal;
+using SeeQuery::Mutation;
+using SeeQuery::Node;
+
+TEST_CASE("Mutations are journaled", "[journal]")
+{
+    SeeQuery::SeeQuery $;
+    Journal& journal = $.document().startJournal(16);
+    REQUIRE(journal.size() == 0);
+
+    $("body").append($("<div/>", {{"id", "panel"}, {"text", "Hello"}}));
+    auto panel = $("#panel");
+    panel.attr("class", "wide");
+    panel.after($("<p/>"));
+    $("p").remove();
+
+    std::vector<Mutation> batch;
+    REQUIRE(journal.drain(batch) == 5);
+    REQUIRE(journal.size() == 0);
+    // The text is inserted into the new div, then the div into the body:
+    REQUIRE(batch[0].type == Mutation::INSERT);
+    REQUIRE(batch[0].parent == batch[1].node);
+    REQUIRE(batch[1].type == Mutation::INSERT);
+    REQUIRE(batch[1].node->attr("id") == "panel");
+    REQUIRE(batch[1].sibling == nullptr);
+    Node* body = batch[1].parent;
+    REQUIRE(static_cast<SeeQuery::HtmlNode*>(body)->tagName() == "body");
+
+    REQUIRE(batch[2].type == Mutation::SET_ATTRIBUTE);
+    REQUIRE(batch[2].node == batch[1].node);
+    REQUIRE(batch[2].key == "class");
+    REQUIRE(batch[2].value == "wide");
+
+    REQUIRE(batch[3].type == Mutation::INSERT);
+    REQUIRE(batch[3].parent == body);
+    REQUIRE(batch[4].type == Mutation::REMOVE);
+    REQUIRE(batch[4].node == batch[3].node);
+    REQUIRE(batch[4].parent == body);
+    REQUIRE(journal.dropped() == 0);
+}
+TEST_CASE("Journal drains in batches and drops the oldest records", "[journal]")
+{
+    SeeQuery::SeeQuery $;
+    Journal& journal = $.document().startJournal(4);
+    auto body = $("body");
+    for (int i = 0; i < 6; ++i) {
+        body.attr("data-i", i);
+    }
+    REQUIRE(journal.size() == 4);
+    REQUIRE(journal.dropped() == 2);
+
+    std::vector<Mutation> batch;
+    REQUIRE(journal.drain(batch, 3) == 3);
+    REQUIRE(batch.front().value == "2");
+    REQUIRE(journal.drain(batch, 3) == 1);
+    REQUIRE(batch.back().value == "5");
+
+    // Stopped journals cost nothing and record nothing:
+    $.document().stopJournal();
+    REQUIRE($.document().journal() == nullptr);
+    body.attr("data-i", 7);
+}
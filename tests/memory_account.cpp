@@ -0,0 +1,197 @@
+#include <string>
+#include <memory>
+#include "catch.hpp"
+#include "../core/collection.h"
+#include "../core/document.h"
+#include "../core/text_node.h"
+
+using SeeQuery::HtmlNode;
+using SeeQuery::MemoryAccount;
+using SeeQuery::MemoryBudgetExceeded;
+using SeeQuery::Node;
+using SeeQuery::TextNode;
+
+namespace
+{
+    size_t subtree_bytes(const Node& node)
+    {
+        return MemoryAccount::total(node.subtreeMemoryUsage());
+    }
+    size_t node_bytes(const MemoryAccount& memory) // without the structures of the document
+    {
+        return memory.used() - memory.used(MemoryAccount::DOCUMENT);
+    }
+}
+
+TEST_CASE("Memory is accounted per document and category", "[memory_account]")
+{
+    SeeQuery::SeeQuery $;
+    MemoryAccount& memory = $.document().memory();
+    Node* root = $("html").get(0);
+    REQUIRE(node_bytes(memory) == subtree_bytes(*root));
+    REQUIRE(memory.used(MemoryAccount::NODES) > 0);
+    size_t base = node_bytes(memory);
+
+    $("body").append($("<p/>", {{"id", "first"}, {"class", "row"}, {"text", "hello"}}));
+    REQUIRE(node_bytes(memory) == subtree_bytes(*root));
+    REQUIRE(memory.used(MemoryAccount::TEXT) == 5);
+    size_t attributes = memory.used(MemoryAccount::ATTRIBUTES);
+    REQUIRE(attributes > 0);
+
+    // Attributes and text charge their growth and release their shrinking:
+    $("#first").attr("title", std::string(1000, 'x'));
+    REQUIRE(memory.used(MemoryAccount::ATTRIBUTES) >= attributes + 1000);
+    $("#first").attr("title", "short");
+    REQUIRE(memory.used(MemoryAccount::ATTRIBUTES) < attributes + 100);
+    $("#first").get(0)->attr("width", SeeQuery::AttributeValue(800));
+    $("#first").get(0)->firstChild()->attr("ignored", "by text nodes");
+    auto text = static_cast<TextNode*>($("#first").get(0)->firstChild());
+    text->appendText(std::string(300, 'y'));
+    text->appendText(*text);
+    REQUIRE(memory.used(MemoryAccount::TEXT) == 610);
+    text->text("bye");
+    REQUIRE(memory.used(MemoryAccount::TEXT) == 3);
+    REQUIRE(node_bytes(memory) == subtree_bytes(*root));
+
+    for (int i = 0; i < 20; ++i) {
+        $("#first").append($("<span/>", {{"class", "cell"}}));
+    }
+    $("body").get(0)->append($("#first").get(0)->clone());
+    REQUIRE(node_bytes(memory) == subtree_bytes(*root));
+    size_t peak = memory.peak();
+    REQUIRE(peak == memory.used());
+
+    // Removed nodes release their bytes once deleted with the last collection:
+    $("body").children().remove();
+    REQUIRE(node_bytes(memory) == base);
+    auto document = $("body").get(0)->ownerDocument();
+    Node* detached = new HtmlNode("div", {{"class", "detached"}}, document);
+    detached->append(new TextNode("deleted with its parent", document));
+    REQUIRE(node_bytes(memory) == base + subtree_bytes(*detached));
+    delete detached;
+    REQUIRE(node_bytes(memory) == base);
+    REQUIRE(memory.peak() == peak);
+    memory.resetPeak();
+    REQUIRE(memory.peak() == memory.used());
+}
+
+TEST_CASE("Nodes moved between documents move their bytes", "[memory_account]")
+{
+    SeeQuery::SeeQuery a;
+    SeeQuery::SeeQuery b;
+    a("body").append(a("<ul/>"));
+    for (int i = 0; i < 10; ++i) {
+        a("ul").append(a("<li/>", {{"text", "item " + std::to_string(i)}}));
+    }
+    Node* list = a("ul").get(0);
+    size_t list_bytes = subtree_bytes(*list);
+    size_t a_used = node_bytes(a.document().memory());
+    size_t b_used = node_bytes(b.document().memory());
+
+    b("body").get(0)->append(list);
+    REQUIRE(node_bytes(a.document().memory()) == a_used - list_bytes);
+    REQUIRE(node_bytes(b.document().memory()) == b_used + list_bytes);
+    REQUIRE(b.document().memory().used(MemoryAccount::TEXT) == 60);
+}
+
+TEST_CASE("Mutations over the memory budget fail cleanly", "[memory_account]")
+{
+    SeeQuery::SeeQuery $;
+    MemoryAccount& memory = $.document().memory();
+    $("body").append($("<p/>", {{"id", "first"}, {"text", "hello"}}));
+    memory.budget(memory.used() + 2000);
+    std::string before = $("html").get(0)->html();
+    size_t used = node_bytes(memory);
+
+    REQUIRE_THROWS_AS($("#first").attr("title", std::string(4000, 'x')), MemoryBudgetExceeded);
+    REQUIRE_THROWS_AS(static_cast<HtmlNode*>($("#first").get(0))->attr(SeeQuery::Attribute("title", std::string(4000, 'x'))),
+        MemoryBudgetExceeded);
+    auto text = static_cast<TextNode*>($("#first").get(0)->firstChild());
+    REQUIRE_THROWS_AS(text->appendText(std::string(4000, 'y')), MemoryBudgetExceeded);
+    REQUIRE_THROWS_AS(text->text(std::string(4000, 'y')), MemoryBudgetExceeded);
+    REQUIRE_THROWS_AS($("<p/>", {{"text", std::string(4000, 'z')}}), MemoryBudgetExceeded);
+    REQUIRE(node_bytes(memory) == used);
+    REQUIRE($("html").get(0)->html() == before);
+
+    // A runaway build stops at the budget, keeping the nodes made so far:
+    size_t added = 0;
+    try {
+        for (;;) {
+            $("body").append($("<div/>", {{"class", "row"}, {"text", "some text"}}));
+            ++added;
+        }
+    } catch (const MemoryBudgetExceeded& e) {
+        REQUIRE(e.budget() == memory.budget());
+        REQUIRE(e.used() + e.requested() > e.budget());
+    }
+    REQUIRE(added > 0);
+    REQUIRE($("div").size() == added);
+    REQUIRE(node_bytes(memory) <= memory.budget());
+    REQUIRE(node_bytes(memory) == subtree_bytes(*$("html").get(0)));
+
+    // Nodes from another document are checked before they are detached:
+    SeeQuery::SeeQuery other;
+    other("body").append(other("<p/>", {{"text", std::string(4000, 'w')}}));
+    Node* big = other("p").get(0);
+    REQUIRE_THROWS_AS($("body").get(0)->append(big), MemoryBudgetExceeded);
+    REQUIRE(big->parent() == other("body").get(0));
+
+    // Freeing memory makes room again:
+    $("div").remove();
+    memory.budget(MemoryAccount::UNLIMITED);
+    $("body").get(0)->append(big);
+    REQUIRE(big->ownerDocument().get() == &$.document());
+}
+
+TEST_CASE("Document structures are charged", "[memory_account]")
+{
+    SeeQuery::SeeQuery $;
+    MemoryAccount& memory = $.document().memory();
+    Node* body = $("body").get(0);
+    for (int i = 0; i < 100; ++i) {
+        body->append(new HtmlNode("p", {}, body->ownerDocument()));
+    }
+    size_t bytes = memory.used(MemoryAccount::DOCUMENT);
+
+    // Child indexes:
+    body->indexChildren(true);
+    size_t indexed = memory.used(MemoryAccount::DOCUMENT);
+    REQUIRE(indexed > bytes + 100 * sizeof(Node*));
+    for (int i = 0; i < 1000; ++i) {
+        body->append(new HtmlNode("p", {}, body->ownerDocument()));
+    }
+    REQUIRE(memory.used(MemoryAccount::DOCUMENT) > indexed + 900 * sizeof(Node*));
+    body->indexChildren(false);
+    REQUIRE(memory.used(MemoryAccount::DOCUMENT) == bytes);
+
+    // The journal:
+    $.document().startJournal(1000);
+    REQUIRE(memory.used(MemoryAccount::DOCUMENT) >= bytes + 1000 * sizeof(SeeQuery::Mutation));
+    body->firstChild()->attr("title", std::string(500, 'x'));
+    REQUIRE(memory.used(MemoryAccount::DOCUMENT) >= bytes + 1000 * sizeof(SeeQuery::Mutation) + 500);
+    $.document().stopJournal();
+    REQUIRE(memory.used(MemoryAccount::DOCUMENT) == bytes);
+
+    // Cached query results:
+    $.document().queryCache().clear();
+    bytes = memory.used(MemoryAccount::DOCUMENT);
+    REQUIRE($("p").size() == 1100);
+    REQUIRE(memory.used(MemoryAccount::DOCUMENT) >= bytes + 1100 * sizeof(Node*));
+    $.document().queryCache().clear();
+    REQUIRE(memory.used(MemoryAccount::DOCUMENT) == bytes);
+
+    // The id and class tables, and the class tokens of the elements:
+    size_t attributes = memory.used(MemoryAccount::ATTRIBUTES);
+    body->firstChild()->attr("id", std::string(200, 'i'));
+    body->firstChild()->attr("class", "one two three");
+    REQUIRE(memory.used(MemoryAccount::DOCUMENT) >= bytes + 200);
+    REQUIRE(memory.used(MemoryAccount::ATTRIBUTES) >= attributes + 3 * sizeof(SeeQuery::ClassList::Token));
+    REQUIRE(node_bytes(memory) == subtree_bytes(*$("html").get(0)));
+
+    // Results that do not fit in the budget are not cached:
+    $.document().queryCache().clear();
+    memory.budget(memory.used() + 100);
+    REQUIRE($("p").size() == 1100);
+    REQUIRE($.document().queryCache().size() == 0);
+    memory.budget(MemoryAccount::UNLIMITED);
+}
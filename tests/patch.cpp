@@ -0,0 +1,210 @@
+#include <memory>
+#include <random>
+#include "catch.hpp"
+#include "../core/patch.h"
+#include "../core/html_node.h"
+#include "../core/text_node.h"
+
+using SeeQuery::Edit;
+using SeeQuery::HtmlNode;
+using SeeQuery::Node;
+using SeeQuery::Patch;
+using SeeQuery::TextNode;
+
+namespace
+{
+    HtmlNode* list(std::initializer_list<const char*> ids)
+    {
+        HtmlNode* ul = new HtmlNode("ul");
+        for (auto id: ids) {
+            ul->append(new HtmlNode("li", {{"id", id}, {"text", id}}));
+        }
+        return ul;
+    }
+    size_t count(const Patch& patch, Edit::Type type)
+    {
+        size_t n = 0;
+        for (auto& e: patch.edits()) {
+            n += e.type == type;
+        }
+        return n;
+    }
+    /* Check that the patch turns a copy of `from` into `to`: */
+    void check(const Patch& patch, const Node& from, const Node& to)
+    {
+        std::unique_ptr<Node> copy{from.clone()};
+        patch.apply(*copy);
+        REQUIRE(copy->serialize() == to.serialize());
+    }
+}
+
+TEST_CASE("Identical trees need no edits", "[patch]")
+{
+    std::unique_ptr<Node> a{list({"a", "b", "c"})};
+    std::unique_ptr<Node> b{a->clone()};
+    REQUIRE(Patch::diff(*a, *b).empty());
+}
+TEST_CASE("Attribute and text changes", "[patch]")
+{
+    HtmlNode a("div", {{"class", "x"}, {"title", "old"}, {"text", "Hello"}});
+    HtmlNode b("div", {{"class", "x"}, {"width", 10}, {"text", "Goodbye"}});
+    Patch patch = Patch::diff(a, b);
+    REQUIRE(count(patch, Edit::REMOVE_ATTRIBUTE) == 1);
+    REQUIRE(count(patch, Edit::SET_ATTRIBUTE) == 1);
+    REQUIRE(count(patch, Edit::SET_TEXT) == 1);
+    REQUIRE(patch.size() == 3);
+    check(patch, a, b);
+    REQUIRE(patch.serialize() == "!\ttitle\n=\twidth\t10\n~0\tGoodbye\n");
+}
+TEST_CASE("Keyed children are moved, not rebuilt", "[patch]")
+{
+    std::unique_ptr<Node> a{list({"a", "b", "c", "d", "e"})};
+    SECTION("Move one to the end")
+    {
+        std::unique_ptr<Node> b{list({"b", "c", "d", "e", "a"})};
+        Patch patch = Patch::diff(*a, *b);
+        REQUIRE(patch.size() == 1);
+        REQUIRE(patch.edits()[0].type == Edit::MOVE);
+        REQUIRE(patch.serialize() == ">0\t4\n");
+        check(patch, *a, *b);
+    }
+    SECTION("Reverse")
+    {
+        std::unique_ptr<Node> b{list({"e", "d", "c", "b", "a"})};
+        Patch patch = Patch::diff(*a, *b);
+        REQUIRE(patch.size() == 4);
+        check(patch, *a, *b);
+    }
+    SECTION("Insert, remove and reorder")
+    {
+        std::unique_ptr<Node> b{list({"c", "x", "a", "e", "y"})};
+        Patch patch = Patch::diff(*a, *b);
+        REQUIRE(count(patch, Edit::REMOVE) == 2);
+        REQUIRE(count(patch, Edit::INSERT) == 2);
+        check(patch, *a, *b);
+    }
+}
+TEST_CASE("Inserted subtrees are serialized compactly", "[patch]")
+{
+    HtmlNode a("body");
+    HtmlNode b("body");
+    b.append(new HtmlNode("p", {{"class", "note"}, {"text", "tab\there"}}));
+    Patch patch = Patch::diff(a, b);
+    REQUIRE(patch.serialize() == "+0\t<p class=\"note\">tab\\there</p>\n");
+    check(patch, a, b);
+}
+TEST_CASE("The compact form parses back", "[patch]")
+{
+    HtmlNode a("body", {{"class", "page"}});
+    a.append(new HtmlNode("p", {{"id", "old"}, {"title", "x"}}));
+    a.append(new TextNode("gone"));
+
+    HtmlNode b("body", {{"class", "page"}});
+    HtmlNode* p = new HtmlNode("p", {{"id", "old"}, {"lang", "a\tb \"q\" \\ <c>"}});
+    b.append(p);
+    HtmlNode* div = new HtmlNode("div", {{"data-x", "1/2"}});
+    div->append(new TextNode("a < b"));
+    div->append(new TextNode("")); // empty and adjacent text nodes survive
+    div->append(new TextNode("\\|"));
+    div->append(new HtmlNode("br"));
+    div->append(new TextNode("line\nbreak"));
+    b.append(div);
+    b.append(new TextNode("<not markup>"));
+
+    Patch patch = Patch::diff(a, b);
+    std::string text = patch.serialize();
+    Patch parsed = Patch::parse(text);
+    REQUIRE(parsed.size() == patch.size());
+    REQUIRE(parsed.serialize() == text);
+    check(parsed, a, b);
+
+    std::unique_ptr<Node> copy{a.clone()};
+    parsed.apply(*copy);
+    Node* inserted = copy->firstChild()->nextSibling();
+    REQUIRE(inserted->getChildren().size() == 5);
+    REQUIRE(static_cast<TextNode*>(inserted->firstChild()->nextSibling())->text().empty());
+    REQUIRE(copy->firstChild()->attr("lang") == "a\tb \"q\" \\ <c>");
+
+    REQUIRE(Patch::parse("").empty());
+    REQUIRE(Patch::parse(">0\t4\n").edits()[0].from == std::vector<size_t>{0});
+    REQUIRE_THROWS_AS(Patch::parse("?0\n"), std::invalid_argument);
+    REQUIRE_THROWS_AS(Patch::parse("-0"), std::invalid_argument);
+    REQUIRE_THROWS_AS(Patch::parse("-\n"), std::invalid_argument);
+    REQUIRE_THROWS_AS(Patch::parse("+0\t<p>x</b>\n"), std::invalid_argument);
+    REQUIRE_THROWS_AS(Patch::parse("+0\t<p>x\n"), std::invalid_argument);
+}
+TEST_CASE("Different roots are rejected", "[patch]")
+{
+    HtmlNode a("div");
+    HtmlNode b("span");
+    REQUIRE_THROWS_AS(Patch::diff(a, b), std::invalid_argument);
+}
+TEST_CASE("Random edits round-trip", "[patch]")
+{
+    std::mt19937 random(42);
+    auto pick = [&](size_t n) { return static_cast<size_t>(random() % n); };
+    const char* tags[] = {"div", "p", "span"};
+
+    std::function<void(HtmlNode*, int)> grow = [&](HtmlNode* node, int depth) {
+        size_t n = pick(5);
+        for (size_t i = 0; i < n; ++i) {
+            if (pick(4) == 0) {
+                node->append(new TextNode("t" + std::to_string(pick(3))));
+                continue;
+            }
+            HtmlNode* child = new HtmlNode(tags[pick(3)]);
+            if (pick(2)) {
+                child->attr("id", "k" + std::to_string(pick(20)));
+            }
+            if (pick(2)) {
+                child->attr("class", "c" + std::to_string(pick(3)));
+            }
+            node->append(child);
+            if (depth < 3) {
+                grow(child, depth + 1);
+            }
+        }
+    };
+    for (int round = 0; round < 50; ++round) {
+        HtmlNode a("body");
+        grow(&a, 0);
+        std::unique_ptr<Node> b{a.clone()};
+        // Mutate the copy: shuffle, drop and add children, change attributes:
+        std::vector<Node*> nodes;
+        std::function<void(Node*)> collect = [&](Node* node) {
+            for (Node* child = node->firstChild(); child; child = child->nextSibling()) {
+                nodes.push_back(child);
+                collect(child);
+            }
+        };
+        collect(b.get());
+        for (int i = 0; i < 5 && !nodes.empty(); ++i) {
+            Node* node = nodes[pick(nodes.size())];
+            switch (pick(4)) {
+            case 0:
+                if (node->parent() && node->parent()->firstChild() != node) {
+                    node->parent()->firstChild()->prevSibling(node);
+                }
+                break;
+            case 1:
+                if (node->nodeType() == Node::ELEMENT_NODE) {
+                    node->attr("class", "changed");
+                }
+                break;
+            case 2:
+                if (node->nodeType() == Node::ELEMENT_NODE) {
+                    node->append(new HtmlNode("em", {{"text", "new"}}));
+                }
+                break;
+            case 3:
+                if (node->nodeType() == Node::TEXT_NODE) {
+                    static_cast<TextNode*>(node)->text("changed");
+                }
+                break;
+            }
+        }
+        check(Patch::diff(a, *b), a, *b);
+        check(Patch::diff(*b, a), *b, a);
+        check(Patch::parse(Patch::diff(a, *b).serialize()), a, *b);
+    }
+}
@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+#include "catch.hpp"
+#include "../core/collection.h"
+#include "../core/fd_writer.h"
+#include "../core/patch.h"
+#include "../core/snapshot.h"
+
+using SeeQuery::AttributeValue;
+using SeeQuery::Node;
+using SeeQuery::Patch;
+using SeeQuery::Snapshot;
+
+TEST_CASE("Snapshot round trip", "[snapshot]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<svg/>", {{"width", 800}, {"height", 600.5}, {"class", "chart wide"}}));
+    for (int i = 0; i < 100; ++i) {
+        $("svg").append($("<g/>", {{"id", "row-" + std::to_string(i)}, {"class", "row"}}));
+        $("#row-" + std::to_string(i))
+            .append($("<rect/>", {{"x", i}, {"y", -i * 0.25}, {"fill", "red"}}))
+            .append($("<text/>", {{"text", "label " + std::to_string(i % 7)}}));
+    }
+    $("#row-3").get(0)->firstChild()->nextSibling()->firstChild()->attr("ignored", "x");
+    Node* body = $("body").get(0);
+
+    std::string data = Snapshot::save(*body);
+    std::unique_ptr<Node> loaded(Snapshot::load(data));
+    REQUIRE(Patch::diff(*body, *loaded).empty());
+    REQUIRE(loaded->serialize().size() == body->serialize().size());
+    Node* rect = loaded->firstChild()->childAt(5)->firstChild();
+    REQUIRE(rect->attrValue("x").type() == AttributeValue::INTEGER);
+    REQUIRE(rect->attrValue("y").type() == AttributeValue::REAL);
+    REQUIRE(rect->attrValue("y").toReal() == -1.25);
+
+    // Loading into a document shares the equal strings:
+    auto document = std::make_shared<SeeQuery::Document>();
+    document->internStrings();
+    std::unique_ptr<Node> pooled(Snapshot::load(data, document));
+    REQUIRE(pooled->ownerDocument() == document);
+    REQUIRE(pooled->getElementsByClassName("row").size() == 100);
+    REQUIRE(pooled->getElementById("row-42") != nullptr);
+    REQUIRE(document->stringPool().size() < 150);
+
+    // A file loads through a memory map:
+    char path[] = "/tmp/seequery-snapshot-XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    {
+        SeeQuery::FdWriter out(fd);
+        Snapshot::save(*body, out);
+    }
+    close(fd);
+    std::unique_ptr<Node> mapped(Snapshot::loadFile(path));
+    std::remove(path);
+    REQUIRE(Patch::diff(*body, *mapped).empty());
+    REQUIRE_THROWS_AS(Snapshot::loadFile(path), std::system_error);
+}
+TEST_CASE("Malformed snapshots are rejected", "[snapshot]")
+{
+    SeeQuery::HtmlNode root("ul");
+    root.append(new SeeQuery::HtmlNode("li", {{"text", "item"}}));
+    std::string data = Snapshot::save(root);
+    std::unique_ptr<Node> loaded(Snapshot::load(data));
+    REQUIRE(loaded->serialize() == root.serialize());
+
+    REQUIRE_THROWS_AS(Snapshot::load(""), std::runtime_error);
+    REQUIRE_THROWS_AS(Snapshot::load("not a snapshot at all, really"), std::runtime_error);
+    std::string version = data;
+    version[4] = 99;
+    REQUIRE_THROWS_AS(Snapshot::load(version), std::runtime_error);
+    REQUIRE_THROWS_AS(Snapshot::load(data.substr(0, data.size() - 1)), std::runtime_error);
+    // Every truncation or corrupted byte fails cleanly, or loads some tree:
+    for (size_t i = 0; i < data.size(); ++i) {
+        REQUIRE_THROWS_AS(Snapshot::load(data.substr(0, i)), std::runtime_error);
+        std::string corrupt = data;
+        corrupt[i] = static_cast<char>(corrupt[i] ^ 0x5a);
+        try {
+            delete Snapshot::load(corrupt);
+        } catch (const std::runtime_error&) {
+        }
+    }
+}
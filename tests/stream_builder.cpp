@@ -0,0 +1,72 @@
+#include <stdexcept>
+#include "catch.hpp"
+#include "../core/collection.h"
+#include "../core/stream_builder.h"
+
+TEST_CASE("Streamed markup matches the serialized tree", "[stream_builder]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<svg/>", {{"width", 800}, {"height", 600}, {"class", "chart"}}));
+    for (int i = 0; i < 3; ++i) {
+        $("svg").append($("<g/>", {{"id", "group-" + std::to_string(i)}}));
+        auto group = $("#group-" + std::to_string(i));
+        group.append($("<rect/>", {{"x", i * 10}, {"y", 0.5}, {"fill", "red"}}));
+        group.append($("<text/>", {{"x", i}, {"text", "label"}}));
+    }
+    $("body").append($("<p/>", {{"text", "one"}, {"text", "two"}}));
+
+    SeeQuery::StringWriter out;
+    {
+        SeeQuery::StreamBuilder stream(out);
+        stream.doctype();
+        auto html = stream("<html/>");
+        stream("<head/>");
+        auto body = stream("<body/>");
+        {
+            auto svg = stream("<svg/>", {{"width", 800}, {"height", 600}, {"class", "chart"}});
+            for (int i = 0; i < 3; ++i) {
+                auto group = stream("<g/>", {{"id", "group-" + std::to_string(i)}});
+                stream("<rect/>", {{"x", i * 10}, {"y", 0.5}, {"fill", "red"}});
+                stream("<text/>", {{"x", i}, {"text", "label"}});
+                REQUIRE(stream.depth() == 4);
+            }
+        }
+        auto p = stream("<p/>");
+        stream.text("one");
+        stream.text("two");
+    }
+    REQUIRE(out.str() == $.serialize());
+}
+TEST_CASE("Stream builder scopes", "[stream_builder]")
+{
+    SeeQuery::StringWriter out;
+    SeeQuery::StreamBuilder stream(out);
+    {
+        auto outer = stream("<a/>");
+        auto inner = stream("<b/>");
+        stream("<c/>");
+        REQUIRE(stream.depth() == 2);
+        outer.close(); // closes `inner` too
+        REQUIRE(stream.depth() == 0);
+    }
+    stream("<d/>");
+    REQUIRE(out.str() == "<a>\n  <b>\n    <c/>\n  </b>\n</a>\n<d/>\n");
+
+    // A scope closed by its parent does not close elements opened later:
+    out.str().clear();
+    {
+        auto outer = stream("<a/>");
+        auto inner = stream("<b/>");
+        outer.close();
+        auto next = stream("<e/>");
+        {
+            auto nested = stream("<f/>");
+            inner.close(); // already closed: a no-op
+            REQUIRE(stream.depth() == 2);
+        }
+        REQUIRE(stream.depth() == 1);
+    } // `inner` ends after `next` and leaves nothing to close
+    REQUIRE(stream.depth() == 0);
+    REQUIRE(out.str() == "<a>\n  <b/>\n</a>\n<e>\n  <f/>\n</e>\n");
+    REQUIRE_THROWS_AS(stream("div"), std::invalid_argument);
+}
@@ -0,0 +1,51 @@
+#include <stdexcept>
+#include "catch.hpp"
+#include "../core/collection.h"
+#include "../core/template.h"
+
+using SeeQuery::Template;
+
+TEST_CASE("Instantiate a fragment template", "[template]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<svg/>"));
+
+    Template rect($("<rect/>", {
+        {"class", "bar"},
+        {"x", Template::slot("x")},
+        {"width", Template::slot("width")},
+        {"text", Template::slot("label")}
+    }));
+    REQUIRE(rect.slots() == 3);
+
+    auto svg = $("svg");
+    for (int i = 0; i < 4; ++i) {
+        svg.append(rect({
+            {"x", i * 10},
+            {"width", 2.5},
+            {"label", "bar " + std::to_string(i)}
+        }));
+    }
+    auto bars = $(".bar");
+    REQUIRE(bars.size() == 4);
+    REQUIRE(bars[2].attr("x") == "20");
+    REQUIRE(bars[2].attrValue("x").type() == SeeQuery::AttributeValue::INTEGER);
+    REQUIRE(bars[2].attr("width") == "2.5");
+    REQUIRE(bars[3].children().size() == 1);
+    REQUIRE(bars[3].serialize().find("bar 3") != std::string::npos);
+
+    SECTION("Unbound slots are dropped")
+    {
+        auto bar = rect({{"x", 1}});
+        REQUIRE(bar.attr("x") == "1");
+        REQUIRE(static_cast<SeeQuery::HtmlNode*>(bar.get(0))->attributes().count("width") == 0);
+        REQUIRE(bar.serialize().find("{{") == std::string::npos);
+        REQUIRE(bar.children().size() == 1);
+        REQUIRE(bar.children().get(0)->text().empty());
+    }
+    SECTION("Bindings must name a slot")
+    {
+        REQUIRE_THROWS_AS(rect({{"x", 1}, {"y", 2}}), std::invalid_argument);
+        REQUIRE(bars.size() == 4);
+    }
+}
@@ -0,0 +1,48 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "catch.hpp"
+#include "../core/thread_pool.h"
+
+TEST_CASE("Submitted tasks all run", "[thread_pool]")
+{
+    SeeQuery::ThreadPool pool(4);
+    REQUIRE(pool.size() == 4);
+    std::atomic<int> count(0);
+    for (int i = 0; i < 1000; ++i) {
+        pool.submit([&]() { ++count; });
+    }
+    pool.wait();
+    REQUIRE(count == 1000);
+}
+TEST_CASE("Parallel for visits every index once", "[thread_pool]")
+{
+    SeeQuery::ThreadPool pool(3);
+    std::vector<int> visits(10000, 0);
+    pool.parallelFor(visits.size(), [&](size_t i) { ++visits[i]; });
+    for (int v: visits) {
+        REQUIRE(v == 1);
+    }
+    pool.parallelFor(0, [](size_t) {});
+}
+TEST_CASE("Parallel for can be nested", "[thread_pool]")
+{
+    SeeQuery::ThreadPool pool(2);
+    std::atomic<int> count(0);
+    pool.parallelFor(8, [&](size_t) {
+        pool.parallelFor(8, [&](size_t) { ++count; });
+    });
+    REQUIRE(count == 64);
+}
+TEST_CASE("Parallel for rethrows", "[thread_pool]")
+{
+    SeeQuery::ThreadPool pool(2);
+    std::atomic<int> count(0);
+    REQUIRE_THROWS_AS(pool.parallelFor(100, [&](size_t i) {
+        ++count;
+        if (i == 50) {
+            throw std::runtime_error("failed");
+        }
+    }), std::runtime_error);
+    REQUIRE(count == 100);
+}
@@ -0,0 +1,40 @@
+#include <string>
+#include "catch.hpp"
+#include "../core/collection.h"
+#include "../core/trace.h"
+
+using SeeQuery::Trace;
+
+TEST_CASE("Recording trace events", "[trace]")
+{
+    SeeQuery::SeeQuery $;
+    $("body")
+    .append($("<div/>", {
+        {"class", "container"}
+    }));
+
+    Trace::clear();
+    REQUIRE(Trace::size() == 0);
+
+    SECTION("Nothing is recorded while tracing is off")
+    {
+        $(".container");
+        REQUIRE(Trace::size() == 0);
+    }
+    SECTION("Top-level operations and outermost traversals are recorded")
+    {
+        Trace::start();
+        $(".container");
+        Trace::stop();
+        // `Collection::operator()` and one `getElementsByClassName` on the root:
+        REQUIRE(Trace::size() == 2);
+
+        std::string json = Trace::json();
+        REQUIRE(json.find("\"traceEvents\"") != std::string::npos);
+        REQUIRE(json.find("\"name\":\"Collection::operator()\"") != std::string::npos);
+        REQUIRE(json.find("\"name\":\"HtmlNode::getElementsByClassName\"") != std::string::npos);
+        REQUIRE(json.find("\"selector\":\".container\",\"size\":1") != std::string::npos);
+        REQUIRE(json.find("\"ph\":\"X\"") != std::string::npos);
+    }
+    Trace::clear();
+}
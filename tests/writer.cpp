@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <sstream>
+#include "catch.hpp"
+#include "../core/collection.h"
+#include "../core/fd_writer.h"
+
+namespace
+{
+    std::string read_all(FILE* file)
+    {
+        std::string result;
+        std::rewind(file);
+        char buffer[4096];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            result.append(buffer, n);
+        }
+        return result;
+    }
+}
+
+TEST_CASE("Serialize to a file descriptor", "[writer][fd_writer]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<svg/>"));
+    auto svg = $("svg");
+    // Enough elements with long values to overflow both the buffer and the iovec array:
+    std::string style(100, 'x');
+    for (int i = 0; i < 2000; ++i) {
+        svg.append($("<rect/>", {
+            {"x", i},
+            {"style", style},
+            {"text", "rect #" + std::to_string(i)}
+        }));
+    }
+
+    FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    {
+        SeeQuery::FdWriter writer(fileno(file), 1024);
+        $.serialize(writer);
+        writer.flush();
+        REQUIRE(writer.bytesWritten() == $.serialize().size());
+    }
+    REQUIRE(read_all(file) == $.serialize());
+    std::fclose(file);
+}
+TEST_CASE("Serialize to a stream", "[writer]")
+{
+    SeeQuery::SeeQuery $;
+    $("body").append($("<p/>", {{"text", "Hello"}}));
+
+    std::ostringstream oss;
+    oss << $;
+    REQUIRE(oss.str() == $.serialize());
+    REQUIRE(oss.str().find("<!DOCTYPE html>\n<html>\n") == 0);
+}